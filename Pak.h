@@ -8,58 +8,144 @@
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <string>
 #include <utility>
+#include <functional>
+#include <memory>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <typeinfo>
+#include <algorithm>
 #include <cstring> //memcpy
 
-//Can be commented out if portability isn't needed
+#if defined(__unix__) || defined(__APPLE__)
+	#define PAK_HAS_MMAP
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+//Selects which archive flavor the Pak typedef names; both BasicPak instantiations are
+//always available below, so native and portable archives can coexist in one binary
 #define PAK_PORTABLE_BINARY
 
-#ifdef PAK_PORTABLE_BINARY
+//Host byte order resolved at compile time, so swap branches fold away entirely on
+//little-endian hosts instead of re-deriving endianness at runtime per element
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	#define PAK_BIG_ENDIAN 1
+#else
+	#define PAK_BIG_ENDIAN 0 //MSVC and every other supported target is little-endian
+#endif
+
+template<typename T>
+typename std::enable_if<(sizeof(T) > 1) && std::is_integral<T>::value, bool>::type
+	shouldByteSwap()
+{
+	return PAK_BIG_ENDIAN != 0;
+}
+
+template<typename T>
+typename std::enable_if<(sizeof(T) == 1) || !std::is_integral<T>::value, bool>::type
+	shouldByteSwap()
+{
+	return false;
+}
 
+template<typename T, std::size_t Size>
+using enable_integral =
+	typename std::enable_if<std::is_integral<T>::value && (sizeof(T) == Size)>::type;
+
+#if defined(_MSC_VER)
+	#include <cstdlib>
+	template<typename T> enable_integral<T, 2> byteSwap(T& t) { t = _byteswap_ushort(t); }
+	template<typename T> enable_integral<T, 4> byteSwap(T& t) { t = _byteswap_ulong(t); }
+	template<typename T> enable_integral<T, 8> byteSwap(T& t) { t = _byteswap_uint64(t); }
+#elif defined(__GNUC__) || defined(__clang__)
+	template<typename T> enable_integral<T, 2> byteSwap(T& t) { t = __builtin_bswap16(t); }
+	template<typename T> enable_integral<T, 4> byteSwap(T& t) { t = __builtin_bswap32(t); }
+	template<typename T> enable_integral<T, 8> byteSwap(T& t) { t = __builtin_bswap64(t); }
+#else
 	template<typename T>
-	typename std::enable_if<(sizeof(T) > 1) && std::is_integral<T>::value, bool>::type
-		shouldByteSwap()
+	void byteSwap(T& t)
 	{
-		int endianTest = 1;
-		bool isBigEndian = (*(std::uint8_t*)&endianTest == 0);
-		return isBigEndian; 
+		auto* begin = (std::uint8_t*)(&t);
+		auto* end = (std::uint8_t*)(&t + 1) - 1;
+
+		while(begin < end)
+			std::swap(*begin++, *end--);
 	}
+#endif
 
-	template<typename T>
-	typename std::enable_if<(sizeof(T) == 1) || !std::is_integral<T>::value, bool>::type
-		shouldByteSwap()
+inline void byteSwap(...) { }
+
+inline bool hostIsBigEndian()
+{
+	return PAK_BIG_ENDIAN != 0;
+}
+
+/*	Vectorized copy+swap kernel
+
+	Copies an array of multi-byte integers while reversing each element's bytes in a
+	single streaming pass, instead of memcpy followed by a scalar swap loop. Sixteen
+	bytes are processed per step with SSSE3 pshufb or NEON vrev when the compiler
+	targets them; otherwise the scalar loop below handles everything. Elements whose
+	size isn't a power of two in [2, 8] never reach this path (shouldByteSwap is false).
+*/
+#if defined(__SSSE3__)
+	#define PAK_SIMD_BYTESWAP
+	#include <tmmintrin.h>
+
+	template<std::size_t Size>
+	void byteSwapCopy16(std::uint8_t* dst, const std::uint8_t* src)
 	{
-		return false;
+		const __m128i mask =
+			Size == 2 ? _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1) :
+			Size == 4 ? _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3) :
+						_mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+		_mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
 	}
+#elif defined(__ARM_NEON)
+	#define PAK_SIMD_BYTESWAP
+	#include <arm_neon.h>
 
-	template<typename T, std::size_t Size>
-	using enable_integral =
-		typename std::enable_if<std::is_integral<T>::value && (sizeof(T) == Size)>::type;
+	template<std::size_t Size>
+	void byteSwapCopy16(std::uint8_t* dst, const std::uint8_t* src)
+	{
+		uint8x16_t v = vld1q_u8(src);
+		vst1q_u8(dst,	Size == 2 ? vrev16q_u8(v) :
+						Size == 4 ? vrev32q_u8(v) :
+									vrev64q_u8(v));
+	}
+#endif
 
-	#if defined(_MSC_VER)
-		#include <cstdlib>
-		template<typename T> enable_integral<T, 2> byteSwap(T& t) { t = _byteswap_ushort(t); }
-		template<typename T> enable_integral<T, 4> byteSwap(T& t) { t = _byteswap_ulong(t); }
-		template<typename T> enable_integral<T, 8> byteSwap(T& t) { t = _byteswap_uint64(t); }
-	#elif defined(__GNUC__) || defined(__clang__)
-		template<typename T> enable_integral<T, 2> byteSwap(T& t) { t = __builtin_bswap16(t); }
-		template<typename T> enable_integral<T, 4> byteSwap(T& t) { t = __builtin_bswap32(t); }
-		template<typename T> enable_integral<T, 8> byteSwap(T& t) { t = __builtin_bswap64(t); }
-	#else
-		template<typename T>
-		void byteSwap(T& t)
-		{
-			auto* begin = (std::uint8_t*)(&t);
-			auto* end = (std::uint8_t*)(&t + 1) - 1;
+template<typename T>
+void byteSwapCopy(T* dst, const T* src, std::size_t numBytes)
+{
+	std::size_t i = 0;
 
-			while(begin < end)
-				std::swap(*begin++, *end--);
-		}
+	#ifdef PAK_SIMD_BYTESWAP
+	if(sizeof(T) >= 2)
+	{
+		for(; i + 16 <= numBytes; i += 16)
+			byteSwapCopy16<sizeof(T)>((std::uint8_t*)dst + i, (const std::uint8_t*)src + i);
+	}
 	#endif
 
-	void byteSwap(...) { }
-
-#endif
+	for(; i < numBytes; i += sizeof(T))
+	{
+		T element = *(const T*)((const std::uint8_t*)src + i);
+		byteSwap(element);
+		*(T*)((std::uint8_t*)dst + i) = element;
+	}
+}
 
 /*	This macro allows for concise expression SFINAE trait definitions
 	
@@ -75,139 +161,2118 @@ struct NAME																						\
 	static const bool value = std::is_same<std::true_type, decltype(test<Type>(0))>::value;		\
 };
 
+//Integral types wide enough to benefit from LEB128 encoding in compact mode
+template<typename T>
+struct is_varintable
+{
+	static const bool value = std::is_integral<T>::value && (sizeof(T) > 1);
+};
+
 DEFINE_TRAIT(is_userdefined_internal, t->serialize(std::declval<Op>()))
 DEFINE_TRAIT(is_userdefined_external, serialize(std::declval<Op>(), *t))
 DEFINE_TRAIT(is_iterator, ++(*t), *(*t)) //Includes pointers
 DEFINE_TRAIT(is_container, t->begin() != t->end(), t->get_allocator()) //Excludes std::array
 DEFINE_TRAIT(is_map, t->emplace_hint(t->end()))
+DEFINE_TRAIT(is_equality_comparable, *t == *t)
+DEFINE_TRAIT(is_hashed, t->hash_function(), t->reserve(0)) //Unordered containers
 #undef DEFINE_TRAIT
 
-class Pak
-{
-public:
-	Pak() {}
+/*	CRC32C kernel for the integrity stage
+
+	Uses the SSE4.2 / ARMv8 CRC instructions when the compiler targets them, falling back
+	to a table-driven byte loop built on first use. Callers seed with 0xFFFFFFFF and xor
+	the final state with 0xFFFFFFFF (the standard CRC32C convention).
+*/
+#if defined(__SSE4_2__)
+	#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+	#include <arm_acle.h>
+#endif
+
+inline std::uint32_t crc32cUpdate(std::uint32_t crc, const std::uint8_t* data, std::size_t numBytes)
+{
+	#if defined(__SSE4_2__)
+		for(; numBytes >= 8; numBytes -= 8, data += 8)
+		{
+			std::uint64_t chunk;
+			std::memcpy(&chunk, data, 8);
+			crc = (std::uint32_t)_mm_crc32_u64(crc, chunk);
+		}
+
+		while(numBytes-- > 0)
+			crc = _mm_crc32_u8(crc, *data++);
+	#elif defined(__ARM_FEATURE_CRC32)
+		for(; numBytes >= 8; numBytes -= 8, data += 8)
+		{
+			std::uint64_t chunk;
+			std::memcpy(&chunk, data, 8);
+			crc = __crc32cd(crc, chunk);
+		}
+
+		while(numBytes-- > 0)
+			crc = __crc32cb(crc, *data++);
+	#else
+		struct Table
+		{
+			std::uint32_t entries[256];
+
+			Table()
+			{
+				for(std::uint32_t i = 0; i < 256; i++)
+				{
+					std::uint32_t value = i;
+					for(int bit = 0; bit < 8; bit++)
+						value = (value >> 1) ^ ((value & 1) ? 0x82F63B78 : 0);
+
+					entries[i] = value;
+				}
+			}
+		};
+
+		static const Table table;
+		while(numBytes-- > 0)
+			crc = (crc >> 8) ^ table.entries[(crc ^ *data++) & 0xFF];
+	#endif
+
+	return crc;
+}
+
+/*	Opt-in fast path for arrays of trivially-serializable user-defined types
+
+	A contiguous range of structs normally dispatches serialize() per element — three
+	scalar copies per Vec3, millions of times for mesh data. Specializing this trait to
+	true lets the contiguous-range machinery blit the whole array with one memcpy:
+
+		template<> struct pak_trivially_serializable<Vec3> : std::true_type {};
+
+	Only opt in if the struct's serialize() lists every member in declaration order and
+	the type has no padding, so its memory image equals its encoded form. On big-endian
+	hosts with the portable format enabled, arrays of such types fall back to per-element
+	dispatch so each field is still byte-swapped correctly.
+*/
+template<typename T>
+struct pak_trivially_serializable : std::false_type {};
+
+/*	Compile-time encoded size
+
+	For types whose encoded size is a compile-time constant — arithmetic scalars, C arrays
+	and std::arrays of such, pairs of such — the Op<Reserve> traversal is pure overhead, so
+	write() uses this trait to pre-size the buffer with a compile-time sum and go straight
+	to Op<Write>. Fixed-layout user-defined types can opt in by specializing:
+
+		template<> struct pak_static_size<Vec3>
+		{
+			static const bool known = true;
+			static const std::size_t value = 3 * sizeof(float);
+		};
+
+	The specialization must match what the type's serialize() actually emits.
+*/
+template<typename T, typename Enable = void>
+struct pak_static_size
+{
+	static const bool known = false;
+	static const std::size_t value = 0;
+};
+
+template<typename T>
+struct pak_static_size<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+	static const bool known = true;
+	static const std::size_t value = sizeof(T);
+};
+
+template<typename T, std::size_t N>
+struct pak_static_size<T[N]>
+{
+	typedef pak_static_size<typename std::remove_cv<T>::type> element;
+	static const bool known = element::known;
+	static const std::size_t value = N * element::value;
+};
+
+template<typename T, std::size_t N>
+struct pak_static_size<std::array<T, N>>
+{
+	typedef pak_static_size<typename std::remove_cv<T>::type> element;
+	static const bool known = element::known;
+	static const std::size_t value = N * element::value;
+};
+
+template<typename T, typename U>
+struct pak_static_size<std::pair<T, U>>
+{
+	typedef pak_static_size<typename std::remove_cv<T>::type> first;
+	typedef pak_static_size<typename std::remove_cv<U>::type> second;
+	static const bool known = first::known && second::known;
+	static const std::size_t value = first::value + second::value;
+};
+
+/*	The archive itself
+
+	The Portable parameter decides the wire byte order at compile time: BasicPak<true>
+	emits the byte-order-independent format, BasicPak<false> emits host order with every
+	swap branch compiled out. SizeType is the container size-prefix policy: std::uint64_t
+	makes archives of over four billion elements encode correctly, std::uint16_t shrinks
+	size prefixes for small-message traffic, and any choice fails loudly instead of
+	truncating a count it can't represent. See the typedefs after the class for the
+	spellings meant for day-to-day use.
+*/
+template<bool Portable, typename SizeType = std::uint32_t>
+class BasicPak
+{
+public:
+	BasicPak() {}
+
+	template<typename... Args>
+	BasicPak(Args&&... args)
+	{
+		write(args...);
+	}
+
+	/*	Creates a non-owning Pak over an external buffer
+
+		The returned Pak reads directly from the caller's memory without copying it into an
+		internal vector, so each byte is only touched once during deserialization. The caller
+		must keep the buffer alive for the lifetime of the view. Writing to a view is not
+		supported.
+	*/
+	static BasicPak view(const std::uint8_t* data, std::size_t size)
+	{
+		BasicPak p;
+		p.viewData = data;
+		p.viewSize = size;
+		return p;
+	}
+
+	#ifdef PAK_HAS_MMAP
+	/*	Creates a Pak over a memory-mapped file
+
+		The file contents are never copied up front; pages are faulted in by the OS as
+		read() or readSpan() walk the mapping, so cold-start cost is proportional to the
+		bytes actually touched. The mapping is released when the last Pak sharing it is
+		destroyed. Returns an empty Pak if the file cannot be mapped.
+	*/
+	static BasicPak mapFile(const char* path)
+	{
+		BasicPak p;
+
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0)
+			return p;
+
+		struct stat info;
+		if(::fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			std::size_t size = static_cast<std::size_t>(info.st_size);
+			void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if(address != MAP_FAILED)
+			{
+				p.viewData = static_cast<const std::uint8_t*>(address);
+				p.viewSize = size;
+				p.mapping = std::shared_ptr<const std::uint8_t>(p.viewData,
+					[size](const std::uint8_t* data) { ::munmap((void*)data, size); });
+			}
+		}
+
+		::close(fd);
+		return p;
+	}
+	#endif
+
+	/*	Reads count elements as a pointer into the underlying buffer without copying
+
+		Intended for views and mapped files: instead of memcpying a contiguous primitive
+		range out of the buffer, the span aliases it directly and the read cursor skips
+		past. The count-less overload consumes a serialized container's size prefix first,
+		so a whole vector can be consumed lazily. The data must outlive the span, and a span
+		cannot alias the buffer when the portable format requires byte swapping or when the
+		cursor isn't aligned for T (a size prefix before 8-byte elements lands the cursor on
+		a 4-byte boundary); either way nullptr is returned and read() must be used instead.
+	*/
+	template<typename T>
+	std::pair<const T*, std::size_t> readSpan(std::size_t count)
+	{
+		static_assert(std::is_arithmetic<T>::value, "readSpan requires a primitive element type");
+
+		if(swapNeeded<T>())
+			return std::pair<const T*, std::size_t>(nullptr, count);
+
+		//A misaligned T* traps on strict-alignment hosts; decline rather than hand one out
+		if(reinterpret_cast<std::uintptr_t>(&readData()[readPosition]) % alignof(T) != 0)
+			return std::pair<const T*, std::size_t>(nullptr, count);
+
+		requireBytes(count * sizeof(T));
+		updateChecksum(&readData()[readPosition], count * sizeof(T));
+		auto* span = reinterpret_cast<const T*>(&readData()[readPosition]);
+		readPosition += count * sizeof(T);
+		return std::pair<const T*, std::size_t>(span, count);
+	}
+
+	template<typename T>
+	std::pair<const T*, std::size_t> readSpan()
+	{
+		return readSpan<T>(read<SizeType>());
+	}
+
+	template<typename... Args>
+	void write(Args&&... args)
+	{
+		if(streamingWrite())
+		{
+			if(bytes.size() != chunkSize)
+				bytes.resize(chunkSize);
+
+			parse(Op<Write>{*this}, args...);
+
+			if(!chunked)
+				flush(); //Chunked storage keeps the partial block resident instead
+		}
+		else if(!compact && static_size<Args...>::known)
+		{
+			//Every argument's encoded size is a compile-time constant: pre-size the
+			//buffer with the static sum and skip the Op<Reserve> traversal entirely
+			bytes.resize(bytes.size() + static_size<Args...>::value);
+			parse(Op<Write>{*this}, args...);
+			bytes.resize(writePosition); //No-op unless gather mode referenced a range
+		}
+		else
+		{
+			reserveSize = 0;
+			parse(Op<Reserve>{*this}, args...);
+			bytes.resize(bytes.size() + reserveSize);
+			parse(Op<Write>{*this}, args...);
+			bytes.resize(writePosition); //Varints and deltas reserve worst case; trim the slack
+		}
+	}
+
+	/*	Serializes in a single traversal, growing the buffer with amortized doubling
+
+		write() walks the argument graph twice: once with Op<Reserve> to pre-size the buffer
+		exactly, then again with Op<Write>. For deep, pointer-heavy graphs the Reserve pass
+		can rival the Write pass in cost, so this variant skips it and grows the buffer as
+		output is produced, trimming the slack afterwards. The encoding is identical; prefer
+		write() when the graph is flat enough that exact pre-sizing is cheap.
+	*/
+	template<typename... Args>
+	void writeSinglePass(Args&&... args)
+	{
+		if(streamingWrite())
+		{
+			write(args...); //Streaming writes are already single-pass
+			return;
+		}
+
+		growing = true;
+		parse(Op<Write>{*this}, args...);
+		growing = false;
+
+		bytes.resize(writePosition);
+	}
+
+	template<typename... Args>
+	void read(Args&&... args)
+	{
+		parse(Op<Read>{*this}, args...);
+	}
+
+	template<typename T>
+	T read()
+	{
+		T t;
+		parse(Op<Read>{*this}, t);
+		return t;
+	}
+
+	/*	Streaming backends
+
+		A Sink receives serialized chunks as write() produces them, so only chunkSize bytes
+		are ever buffered internally instead of the whole payload. A Source supplies bytes to
+		read() on demand, pulling incrementally from a file, socket, or user callback.
+	*/
+	typedef std::function<void(const std::uint8_t*, std::size_t)> Sink;
+	typedef std::function<std::size_t(std::uint8_t*, std::size_t)> Source;
+
+	void setSink(Sink s, std::size_t sinkChunkSize = 65536)
+	{
+		sink = std::move(s);
+		chunkSize = sinkChunkSize < 64 ? 64 : sinkChunkSize;
+	}
+
+	void setSource(Source s, std::size_t sourceChunkSize = 65536)
+	{
+		source = std::move(s);
+		chunkSize = sourceChunkSize < 64 ? 64 : sourceChunkSize;
+		bytes.clear();
+		readPosition = 0;
+		sourceEnd = 0;
+	}
+
+	/*	Block compression riding the streaming backends
+
+		Compressing a finished Pak as a post-pass buffers the payload twice and walks the
+		data twice. Plugging a codec into the streaming path instead compresses each sink
+		chunk as write() seals it, so peak memory stays at one block and the bytes are
+		compressed while still hot. Each block is framed as
+
+			[compressed size][uncompressed size][compressed bytes]
+
+		with a block stored raw (both sizes equal) when the codec can't shrink it. The read
+		side decompresses frames on demand as the cursor approaches them. A Codec fills dst
+		from src and returns the bytes produced, or 0 if dst is too small — the natural shape
+		of LZ4_compress_default(), ZSTD_compress(), and their decompress counterparts:
+
+			p.setSink(fileSink, 1 << 16);
+			p.setCompressor([](std::uint8_t* dst, std::size_t cap, const std::uint8_t* src, std::size_t n)
+				{ return (std::size_t)ZSTD_compress(dst, cap, src, n, 3); });
+
+		The block size is the chunk size given to setSink()/setSource(). Both sides must
+		agree on the framing; a compressed stream can't be read without a decompressor.
+	*/
+	typedef std::function<std::size_t(std::uint8_t* dst, std::size_t dstCapacity,
+									  const std::uint8_t* src, std::size_t srcSize)> Codec;
+
+	void setCompressor(Codec codec)
+	{
+		compressor = std::move(codec);
+	}
+
+	void setDecompressor(Codec codec)
+	{
+		decompressor = std::move(codec);
+	}
+
+	/*	Resumable deserialization overlapping the network receive
+
+		read() needs its payload buffered up front, so a receive loop pays a whole
+		message-size of latency before parsing can even start. readAsync() instead runs the
+		read on a worker thread against a blocking source: each feed() hands over the next
+		received chunk, the parse consumes exactly as far as those bytes allow and suspends
+		at the field boundary where they run out, and finish() marks end-of-stream, joins,
+		and rethrows anything the parse threw. feed() returns once its chunk is fully
+		consumed, so the caller's receive buffer can be reused immediately. The target
+		objects must stay alive until finish() returns; the compact, hardened, decode-limit,
+		and decompressor settings of this Pak carry over to the worker.
+
+			auto job = p.readAsync(frame);
+			while(receiving)
+				job.feed(buffer, received);
+			job.finish();
+	*/
+	class ReadJob
+	{
+	public:
+		void feed(const std::uint8_t* data, std::size_t numBytes)
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->chunk = data;
+			state->size = numBytes;
+			state->used = 0;
+			state->ready.notify_all();
+			state->ready.wait(lock, [this] { return state->used == state->size || state->done; });
+		}
+
+		void finish()
+		{
+			endStream();
+
+			if(worker.joinable())
+				worker.join();
+
+			if(state->error)
+				std::rethrow_exception(state->error);
+		}
+
+		~ReadJob()
+		{
+			if(state && worker.joinable())
+			{
+				endStream();
+				worker.join();
+			}
+		}
+
+		ReadJob(ReadJob&&) = default;
+		ReadJob& operator=(ReadJob&&) = default;
+
+	private:
+		friend BasicPak;
+
+		ReadJob() {}
+
+		void endStream()
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->ended = true;
+			state->ready.notify_all();
+		}
+
+		struct State
+		{
+			std::mutex mutex;
+			std::condition_variable ready;
+			const std::uint8_t* chunk = nullptr;
+			std::size_t size = 0;
+			std::size_t used = 0;
+			bool ended = false;
+			bool done = false;
+			std::exception_ptr error;
+		};
+
+		std::shared_ptr<State> state;
+		std::thread worker;
+	};
+
+	template<typename... Args>
+	ReadJob readAsync(Args&... args)
+	{
+		ReadJob job;
+		job.state = std::make_shared<typename ReadJob::State>();
+
+		auto state = job.state;
+		bool useCompact = compact;
+		bool useChecked = checked;
+		bool useLimited = limited;
+		DecodeLimits caps = decodeLimits;
+		Codec codec = decompressor;
+
+		job.worker = std::thread([state, useCompact, useChecked, useLimited, caps, codec, &args...]
+		{
+			BasicPak p;
+			p.setSource([state](std::uint8_t* dst, std::size_t numBytes) -> std::size_t
+			{
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->ready.wait(lock, [&] { return state->used < state->size || state->ended; });
+
+				if(state->used == state->size)
+					return 0; //End of stream
+
+				std::size_t step = numBytes < state->size - state->used
+					? numBytes : state->size - state->used;
+				std::memcpy(dst, state->chunk + state->used, step);
+				state->used += step;
+
+				if(state->used == state->size)
+					state->ready.notify_all(); //Chunk drained, release the feeder
+
+				return step;
+			});
+
+			p.compact = useCompact;
+			p.checked = useChecked;
+			p.limited = useLimited;
+			p.decodeLimits = caps;
+			p.decompressor = codec;
+
+			try { p.read(args...); }
+			catch(...) { state->error = std::current_exception(); }
+
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->done = true;
+			state->ready.notify_all();
+		});
+
+		return job;
+	}
+
+	/*	Incremental reserialization of retained Paks
+
+		For objects serialized repeatedly with few changes between frames, capture field
+		offsets with writeOffset() during the initial write() — serialize() bodies can use
+		the public Op::pak member for this — then rewrite only the dirty members in place:
+
+			std::size_t balanceOffset = p.writeOffset();	//during the initial write
+			...
+			p.writeAt(balanceOffset, newBalance);			//per frame, clean fields untouched
+
+		writeAt() is meant for fixed-size fields: the new encoding must occupy exactly the
+		bytes the old one did, or the fields after it are corrupted (the buffer itself is
+		bounds-protected). For variable-size changes, rewind(offset) discards everything
+		from a captured offset on so the dirty suffix can be re-encoded with write().
+	*/
+	std::size_t writeOffset() const
+	{
+		return writePosition;
+	}
+
+	template<typename... Args>
+	void writeAt(std::size_t offset, Args&&... args)
+	{
+		std::size_t needed = static_size<Args...>::value;
+
+		if(!static_size<Args...>::known)
+		{
+			reserveSize = 0;
+			parse(Op<Reserve>{*this}, args...);
+			needed = reserveSize;
+		}
+
+		if(offset + needed > bytes.size())
+			throw std::out_of_range("Pak: writeAt past end of buffer");
+
+		std::size_t saved = writePosition;
+		bool hashing = checksumEnabled;
+
+		checksumEnabled = false; //The digest reflects bytes in first-append order only
+		writePosition = offset;
+		parse(Op<Write>{*this}, args...);
+		writePosition = saved;
+		checksumEnabled = hashing;
+	}
+
+	void rewind(std::size_t offset)
+	{
+		bytes.resize(offset);
+		writePosition = offset;
+	}
+
+	/*	Reuse lifecycle for per-message hot paths
+
+		Constructing a fresh Pak per RPC message pays a vector allocation every time.
+		clear() instead rewinds the cursors and per-payload state while keeping the buffer's
+		capacity and the configured flags and backends, so a retained Pak serializes message
+		after message without touching the allocator once its buffer has grown to the
+		working-set size. Any view or mapping is released, returning the Pak to owned
+		storage.
+	*/
+	void clear()
+	{
+		bytes.resize(0); //Keeps capacity; the next write resizes within it, no reallocation
+		writePosition = 0;
+		readPosition = 0;
+		reserveSize = 0;
+		sourceEnd = 0;
+		checksumState = 0xFFFFFFFF;
+		gatherMark = 0;
+		gatherPieces.clear();
+		chunks.clear();
+		viewData = nullptr;
+		viewSize = 0;
+		mapping.reset();
+		internWrite.clear();
+		internRead.clear();
+		decodedElements = 0;
+		decodeDepth = 0;
+	}
+
+	/*	Length-prefixed frames for packing many messages into one retained buffer
+
+		beginFrame() reserves a fixed-width length prefix and endFrame() patches it with the
+		bytes the message actually took, so a batch of small messages shares one buffer and
+		one eventual send:
+
+			std::size_t frame = p.beginFrame();
+			p.write(header, body);
+			p.endFrame(frame);				//repeat per message, then send p.data()
+
+		The reader mirrors it: readFrame() consumes the prefix and returns where the frame
+		ends, and finishFrame() skips there — fields a newer writer appended inside the
+		frame are passed over cleanly. The prefix stays fixed-width in compact mode so the
+		patch always fits, and patching needs random-access storage, as with writeAt().
+	*/
+	std::size_t beginFrame()
+	{
+		if(streamingWrite())
+			throw std::logic_error("Pak: frame patching requires random-access storage");
+
+		std::size_t frame = writePosition;
+		growing = true;
+		writeFixed(std::uint32_t(0));
+		growing = false;
+		bytes.resize(writePosition);
+		return frame;
+	}
+
+	void endFrame(std::size_t frame)
+	{
+		auto length = static_cast<std::uint32_t>(writePosition - frame - sizeof(std::uint32_t));
+		std::size_t saved = writePosition;
+		bool hashing = checksumEnabled;
+
+		checksumEnabled = false; //Patches aren't re-hashed, like writeAt()
+		writePosition = frame;
+		writeFixed(length);
+		writePosition = saved;
+		checksumEnabled = hashing;
+	}
+
+	std::size_t readFrame()
+	{
+		std::uint32_t length;
+		readFixed(length);
+		requireBytes(length);
+		return readPosition + length;
+	}
+
+	void finishFrame(std::size_t end)
+	{
+		readPosition = end;
+	}
+
+	/*	Gather-mode serialization for zero-copy sends
+
+		With gather mode enabled, contiguous primitive ranges of at least minBytes are not
+		copied into the buffer; they are recorded as references to the caller's memory.
+		gatherSegments() then yields the encoded stream as an iovec-style (pointer, length)
+		list — small Pak-owned header runs interleaved with the original arrays — ready for
+		writev/sendmsg. Concatenating the segments reproduces write()'s exact byte stream.
+
+		The caller must keep the source arrays alive and unmodified until the segments have
+		been sent. Ranges whose elements need byte swapping for the portable format can't
+		alias the source and are copied as usual.
+	*/
+	struct Segment
+	{
+		const void* data;
+		std::size_t size;
+	};
+
+	void enableGatherWrite(std::size_t minBytes = 4096)
+	{
+		gatherMinBytes = minBytes;
+	}
+
+	std::vector<Segment> gatherSegments()
+	{
+		closeGatherRun(); //Capture the trailing Pak-owned run
+
+		std::vector<Segment> segments;
+		segments.reserve(gatherPieces.size());
+
+		for(auto& piece : gatherPieces)
+			segments.push_back(Segment{piece.external ? piece.external : bytes.data() + piece.offset,
+									   piece.size});
+
+		return segments;
+	}
+
+	/*	Opts reads into hardened mode for untrusted input
+
+		Validation is batched to stay cheap: one comparison per contiguous range, one per
+		container size prefix (rejecting hostile counts that exceed the remaining bytes
+		before any allocation happens), and one per scalar. Violations throw
+		std::out_of_range or std::length_error. Off by default, costing nothing.
+	*/
+	void enableBoundsChecking(bool enabled = true)
+	{
+		checked = enabled;
+	}
+
+	/*	Decode-cost budgets for hostile or degenerate input
+
+		Bounds checking rejects prefixes that overrun the buffer, but a stream can be
+		well-formed and still pathological: deeply nested containers recurse through parse()
+		thousands of frames deep, and a run of large size prefixes that each survive the
+		remaining-bytes check can together stall a decode thread for seconds. These limits
+		cap the total work a single decode may perform — elements decoded (string characters
+		included), bytes consumed, and container nesting depth — and each container read
+		charges its size prefix against the budget up front, throwing std::length_error the
+		moment a cap is crossed. Worst-case decode time is then bounded by policy rather
+		than by the input. Counters reset on clear(); the caps themselves persist.
+	*/
+	struct DecodeLimits
+	{
+		std::size_t maxElements;
+		std::size_t maxBytes;
+		std::size_t maxDepth;
+	};
+
+	void setDecodeLimits(DecodeLimits caps)
+	{
+		decodeLimits = caps;
+		limited = true;
+		decodedElements = 0;
+		decodeDepth = 0;
+	}
+
+	/*	Opt-in CRC32C digest computed alongside the copy passes
+
+		The accumulator is updated at the points where encoded bytes are produced or
+		consumed — while the data is already in cache — so enabling it costs a fused CRC
+		update per copy instead of a separate pass over the whole stream. After write(),
+		checksum() returns the digest of every byte appended so far; the reader enables
+		the same flag, reads the payload, and compares its checksum() against the
+		transmitted digest. Hardware CRC instructions are used when the build targets
+		them. writeAt() patches are not re-hashed: the digest reflects bytes in the order
+		they were first appended. The indexed calls throw when the checksum is enabled —
+		no consistent digest exists for that layout. Off by default, costing nothing.
+	*/
+	void enableChecksum(bool enabled = true)
+	{
+		checksumEnabled = enabled;
+		checksumState = 0xFFFFFFFF;
+	}
+
+	std::uint32_t checksum() const
+	{
+		return checksumState ^ 0xFFFFFFFF;
+	}
+
+	/*	Opt-in accounting pass over the serialization graph
+
+		profile() walks the same parse() overload set as write() with an Op<Profile> pass
+		that touches no buffer; it attributes encoded bytes, element counts, and visit
+		counts to each type encountered, with user-defined types charged for their whole
+		subtree. The report is sorted by bytes, so "which member is 80% of this snapshot"
+		is the first few lines:
+
+			for(auto& entry : p.profile(state))
+				std::printf("%10zu bytes  %8zu elems  %s\n",
+							entry.bytes, entry.elements, entry.type.c_str());
+
+		Byte counts reflect this Pak's settings (compact varints are measured at their
+		actual encoded width). Nothing is instantiated or stored unless profile() is
+		called, so the pass costs nothing when unused.
+	*/
+	struct ProfileEntry
+	{
+		std::string type;		//typeid name, compiler-mangled on some toolchains
+		std::size_t bytes;		//Encoded bytes attributed to the type, subtree included
+		std::size_t elements;	//Scalars or range elements visited
+		std::size_t visits;		//Times a value of the type was entered
+	};
+
+	template<typename... Args>
+	std::vector<ProfileEntry> profile(Args&&... args)
+	{
+		profileEntries.clear();
+		profileBytes = 0;
+		parse(Op<Profile>{*this}, args...);
+
+		std::vector<ProfileEntry> report;
+		report.reserve(profileEntries.size());
+		for(auto& entry : profileEntries)
+			report.push_back(entry.second);
+
+		std::sort(report.begin(), report.end(),
+				  [](const ProfileEntry& a, const ProfileEntry& b) { return a.bytes > b.bytes; });
+
+		return report;
+	}
+
+	/*	Opts large contiguous ranges into multi-threaded copying
+
+		Op<Reserve> sizes the buffer before Op<Write> runs, so every range's destination
+		slice is known and disjoint; ranges of at least minBytes are partitioned across the
+		hardware threads and copied (with any byte swapping) in parallel. Pass 0 to disable.
+		Smaller ranges and sink-backed writes stay single-threaded.
+	*/
+	void enableParallelWrite(std::size_t minBytes = 1 << 22)
+	{
+		parallelMinBytes = minBytes;
+	}
+
+	/*	Opts integral fields and container size prefixes into LEB128 varint encoding
+
+		Multi-byte integers (including the container size prefixes) are written as
+		variable-length LEB128, with ZigZag applied to signed types, so values under 128
+		cost one byte instead of four or eight. Floats, single-byte types, and contiguous
+		primitive ranges keep the fixed-width fast path. Both writer and reader must agree
+		on this setting — it changes the wire format.
+	*/
+	void setCompactIntegers(bool enabled = true)
+	{
+		compact = enabled;
+	}
+
+	/*	Wraps a sorted integer range for delta + varint encoding
+
+		Each element is encoded as the ZigZag varint of its difference from the previous
+		one, so sorted ID ranges cost about a byte per element. Like raw iterator pairs,
+		no element count is prepended; the reader must supply a range of the same length.
+
+			p.write(Pak::delta(ids.begin(), ids.end()));
+			p.read(Pak::delta(ids.begin(), ids.end()));
+	*/
+	template<typename Iterator>
+	struct DeltaRange
+	{
+		Iterator begin, end;
+	};
+
+	template<typename Iterator>
+	static DeltaRange<Iterator> delta(Iterator begin, Iterator end)
+	{
+		return DeltaRange<Iterator>{begin, end};
+	}
+
+	/*	Rope storage: a list of fixed-size blocks instead of one growing vector
+
+		Appending many messages into one Pak with vector storage relocates everything
+		already written whenever the vector outgrows its capacity. Chunked storage seals
+		full blocks into a list and keeps writing into a fresh block, so previously
+		serialized bytes never move. The result is exposed as ordered segments (the sealed
+		blocks plus the live partial block) for segment-aware senders; data()/size() do
+		not apply in this mode.
+	*/
+	void enableChunkedStorage(std::size_t blockSize = 1 << 20)
+	{
+		chunked = true;
+		chunkSize = blockSize < 64 ? 64 : blockSize;
+		chunks.clear();
+	}
+
+	std::vector<Segment> storageSegments() const
+	{
+		std::vector<Segment> segments;
+		segments.reserve(chunks.size() + 1);
+
+		for(auto& chunk : chunks)
+			segments.push_back(Segment{chunk.data(), chunk.size()});
+
+		if(writePosition > 0)
+			segments.push_back(Segment{bytes.data(), writePosition});
+
+		return segments;
+	}
+
+	/*	Batched encoding for containers of many small strings
+
+		The plain encoding interleaves each string's length with its characters, paying a
+		size-prefix parse and a dispatch per string. The block layout groups all lengths
+		into one contiguous array followed by the character data:
+
+			[count][lengths...][chars of string 0][chars of string 1]...
+
+		so reading is one bulk length read plus an allocation-free assign per string. The
+		two calls are a matched pair; the layout differs from a plain write().
+	*/
+	template<typename T>
+	void writeStringBlock(T& strings)
+	{
+		auto count = checkedSize(strings.size());
+
+		std::vector<SizeType> lengths;
+		lengths.reserve(count);
+		for(auto& s : strings)
+			lengths.push_back(checkedSize(s.size()));
+
+		write(count);
+		write(lengths.begin(), lengths.end());
+
+		for(auto& s : strings)
+			writeSinglePass(s.begin(), s.end());
+	}
+
+	template<typename T>
+	void readStringBlock(T& strings)
+	{
+		auto count = read<SizeType>();
+		requireElements(count);
+
+		std::vector<SizeType> lengths(count);
+		read(lengths.begin(), lengths.end());
+
+		strings.resize(count);
+
+		auto it = strings.begin();
+		for(SizeType i = 0; i < count; i++, ++it)
+			readStringChars(*it, lengths[i]);
+	}
+
+	/*	Deduplicating string interning
+
+		Payloads that repeat a few hundred distinct strings millions of times (map keys,
+		enum-like tags) re-encode every occurrence in full. With interning enabled the
+		write path keeps a hash table of strings already emitted and encodes repeats as a
+		compact back-reference — the size prefix's low bit distinguishes a literal
+		(length << 1) from a reference (id << 1 | 1) — and the read path rebuilds from a
+		dictionary, assigning repeats from the already-decoded entry instead of re-parsing
+		the bytes. Both sides must enable it: it changes the string wire format. The
+		dictionaries persist across write()/read() calls until clear(), so a long-lived
+		Pak amortizes them across messages. Only plain char strings participate; other
+		character types keep the normal encoding.
+	*/
+	void enableInterning(bool enabled = true)
+	{
+		interning = enabled;
+		internWrite.clear();
+		internRead.clear();
+	}
+
+	/*	Structure-of-arrays encoding for containers of user-defined types
+
+		Element-wise serialization interleaves a struct's fields on the wire, which is the
+		worst case for a compressor — every few bytes the value distribution changes.
+		writeSoA() instead walks the member list (the same t(a, b, c) pattern serialize()
+		already declares) once per field, so each field forms one contiguous column:
+
+			[count][field 0 of every element][field 1 of every element]...
+
+		Same-typed runs compress far better than interleaved ones, and nested members
+		(a vector inside each element) end up grouped with their kind too. readSoA()
+		reassembles the elements field by field. The two calls are a matched pair — the
+		column layout differs from a plain write() — and every element must list the same
+		fields in the same order, which the t(a, b, c) pattern already guarantees.
+	*/
+	template<typename T>
+	void writeSoA(T& container)
+	{
+		auto count = checkedSize(container.size());
+
+		if(streamingWrite())
+		{
+			write(count);
+			writeSoAColumns(container);
+
+			if(!chunked)
+				flush();
+
+			return;
+		}
+
+		growing = true;
+		parse(Op<Write>{*this}, count);
+		writeSoAColumns(container);
+		growing = false;
+		bytes.resize(writePosition);
+	}
+
+	template<typename T>
+	void readSoA(T& t)
+	{
+		auto count = read<SizeType>();
+		requireElements(count);
+		t.resize(count);
+
+		if(t.begin() == t.end())
+			return;
+
+		std::size_t numFields = fieldCount(*t.begin());
+		for(std::size_t field = 0; field < numFields; field++)
+			for(auto it = t.begin(); it != t.end(); ++it)
+				fieldDispatch(FieldOp<Read>{this, field}, *it);
+	}
+
+	/*	Indexed container format for parallel deserialization
+
+		Normal container encoding is inherently serial to read — element N+1 can only be
+		found by parsing element N. writeIndexed() emits a variant that prepends a compact
+		table with the byte offset of every stride-th element:
+
+			[count][stride][table size][offset table][elements...]
+
+		readIndexed() uses the table to hand disjoint element ranges to worker threads,
+		each parsing through its own view of the buffer, and merges the results in order.
+		Both sides must use the indexed calls — the layout differs from a plain write().
+		Patching the table requires random access, so indexed writes don't combine with
+		sinks or chunked storage, and indexed reads need the whole payload present (a
+		view, mapping, or fully-buffered Pak rather than an incremental source). The
+		checksum doesn't combine with this layout either — the table is patched after the
+		digest has passed it, and parallel readers consume bytes out of order — so both
+		calls throw when it is enabled.
+	*/
+	template<typename T>
+	void writeIndexed(T& container, std::uint32_t stride = 1024)
+	{
+		if(streamingWrite())
+			throw std::logic_error("Pak: indexed writes require random-access storage");
+
+		//The table is patched after the digest has passed it and parallel readers consume
+		//element bytes out of order, so no consistent digest exists for this layout
+		if(checksumEnabled)
+			throw std::logic_error("Pak: checksum does not cover the indexed format");
+
+		auto numElements = checkedSize(container.size());
+		std::uint64_t numOffsets = (std::size_t(numElements) + stride - 1) / stride;
+		write(numElements, stride, numOffsets);
+
+		std::size_t tableOffset = writePosition;
+		std::vector<std::uint64_t> offsets(numOffsets, 0);
+
+		//The table is patched in place once the elements have landed, so its entries must
+		//stay fixed width even in compact mode — varint placeholders would change length
+		//when patched and shift the element bytes they sit in front of
+		growing = true;
+		for(auto& offset : offsets)
+			writeFixed(offset);
+		growing = false;
+		bytes.resize(writePosition);
+
+		std::size_t dataStart = writePosition;
+		std::size_t i = 0;
+
+		for(auto it = container.begin(); it != container.end(); ++it, i++)
+		{
+			if(i % stride == 0)
+				offsets[i / stride] = writePosition - dataStart;
+
+			writeSinglePass(*it);
+		}
+
+		std::size_t saved = writePosition;
+		bool hashing = checksumEnabled;
+
+		checksumEnabled = false; //Patches aren't re-hashed, like writeAt()
+		writePosition = tableOffset;
+		for(auto& offset : offsets)
+			writeFixed(offset);
+		writePosition = saved;
+		checksumEnabled = hashing;
+	}
+
+	template<typename T>
+	void readIndexed(T& t, std::size_t numThreads = std::thread::hardware_concurrency())
+	{
+		if(checksumEnabled)
+			throw std::logic_error("Pak: checksum does not cover the indexed format");
+
+		SizeType numElements;
+		std::uint32_t stride;
+		std::uint64_t numOffsets;
+		read(numElements, stride, numOffsets);
+		requireElements(numElements);
+
+		std::vector<std::uint64_t> offsets(numOffsets);
+		for(auto& offset : offsets)
+			readFixed(offset); //The table is fixed width regardless of compact mode
+		std::size_t dataStart = readPosition;
+
+		typedef typename element_of<T, is_map<T>::value>::type Element;
+
+		t.clear();
+
+		//Interned payloads parse serially: back-references reach across group boundaries,
+		//so the dictionary only resolves when built in stream order
+		if(numThreads < 2 || numOffsets < 2 || source || interning)
+		{
+			for(std::size_t i = 0; i < numElements; i++)
+				t.insert(t.end(), read<Element>());
+
+			return;
+		}
+
+		//Each worker parses a disjoint run of elements through its own view, landing in a
+		//per-worker batch; batches are merged in element order afterwards
+		std::size_t numGroups = numThreads < numOffsets ? numThreads : numOffsets;
+		std::size_t entriesPerGroup = (numOffsets + numGroups - 1) / numGroups;
+
+		//The ceil division can strand a trailing group past the table (4 entries on 3
+		//threads gives 2 per group and an empty group 2); recompute so every group owns
+		//at least one entry and never indexes offsets[] out of bounds
+		numGroups = (std::size_t(numOffsets) + entriesPerGroup - 1) / entriesPerGroup;
+
+		std::vector<std::vector<Element>> batches(numGroups);
+		std::vector<std::future<std::size_t>> tasks;
+
+		for(std::size_t group = 0; group < numGroups; group++)
+		{
+			tasks.push_back(std::async(std::launch::async, [&, group]() -> std::size_t
+			{
+				std::size_t firstEntry = group * entriesPerGroup;
+				std::size_t firstElement = firstEntry * stride;
+				std::size_t lastElement = (firstEntry + entriesPerGroup) * std::size_t(stride);
+				if(lastElement > std::size_t(numElements))
+					lastElement = numElements;
+
+				BasicPak worker = view(readData(), readLimit());
+				worker.compact = compact;
+				worker.checked = checked;
+				worker.limited = limited;
+				worker.decodeLimits = decodeLimits; //Each worker budgets its own slice
+				worker.readPosition = dataStart + offsets[firstEntry];
+
+				auto& batch = batches[group];
+				batch.reserve(lastElement - firstElement);
+
+				for(std::size_t i = firstElement; i < lastElement; i++)
+					batch.push_back(worker.read<Element>());
+
+				return worker.readPosition;
+			}));
+		}
+
+		std::size_t endPosition = dataStart;
+		for(auto& task : tasks)
+			endPosition = task.get();
+
+		for(auto& batch : batches)
+			for(auto& element : batch)
+				t.insert(t.end(), std::move(element));
+
+		readPosition = endPosition;
+	}
+
+	/*	Field-indexed records for partial reads
+
+		Sequential parsing means extracting one field from the middle of a record costs a
+		full deserialization of everything before it. writeFields() serializes its arguments
+		like write() and then appends a footer with the byte offset of each top-level
+		argument:
+
+			[field 0][field 1]...[offset table][field count]
+
+		readField<T>(index) seeks straight to one field and decodes just that, leaving the
+		read cursor where it was — reading 2 of 200 fields costs 2 field decodes plus a
+		footer lookup. Offsets are relative to the start of the record, so readers should
+		view the record itself (the usual shape for stored blobs). Nested members can be
+		exposed by lifting them to top-level arguments, or located manually with
+		writeOffset() during the write. The footer requires patch-free random-access
+		storage and a fully-present payload, like the indexed container format.
+	*/
+	template<typename... Args>
+	void writeFields(Args&&... args)
+	{
+		if(streamingWrite())
+			throw std::logic_error("Pak: field-indexed writes require random-access storage");
+
+		std::size_t start = writePosition;
+		std::vector<std::uint64_t> offsets;
+		offsets.reserve(sizeof...(Args));
+		writeFieldsImpl(start, offsets, std::forward<Args>(args)...);
+
+		growing = true;
+		for(auto offset : offsets)
+			writeFixed(offset);
+
+		writeFixed(static_cast<std::uint32_t>(offsets.size()));
+		growing = false;
+		bytes.resize(writePosition);
+	}
+
+	template<typename T>
+	T readField(std::size_t index)
+	{
+		if(source)
+			throw std::logic_error("Pak: field reads need the whole payload present");
+
+		std::size_t limit = readLimit();
+		std::size_t saved = readPosition;
+
+		if(checked && limit < sizeof(std::uint32_t))
+			throw std::out_of_range("Pak: no field footer present");
+
+		readPosition = limit - sizeof(std::uint32_t);
+		std::uint32_t count;
+		readFixed(count);
+
+		if(checked && sizeof(std::uint32_t) + count * sizeof(std::uint64_t) > limit)
+		{
+			readPosition = saved;
+			throw std::length_error("Pak: field table exceeds payload");
+		}
+
+		if(index >= count)
+		{
+			readPosition = saved;
+			throw std::out_of_range("Pak: field index out of range");
+		}
+
+		readPosition = limit - sizeof(std::uint32_t) - (count - index) * sizeof(std::uint64_t);
+		std::uint64_t offset;
+		readFixed(offset);
+
+		//A hostile offset past the fields (or into the footer itself) would park the
+		//cursor where unsigned remaining-bytes arithmetic underflows; reject before seeking
+		std::size_t footerStart = limit - sizeof(std::uint32_t) - count * sizeof(std::uint64_t);
+		if(checked && offset > footerStart)
+		{
+			readPosition = saved;
+			throw std::out_of_range("Pak: field offset past end of payload");
+		}
+
+		readPosition = static_cast<std::size_t>(offset);
+		T t;
+		parse(Op<Read>{*this}, t);
+		readPosition = saved;
+		return t;
+	}
+
+	void flush()
+	{
+		if(writePosition == 0)
+			return;
+
+		if(chunked)
+		{
+			bytes.resize(writePosition);
+			chunks.push_back(std::move(bytes));
+			bytes = std::vector<std::uint8_t>();
+			bytes.resize(chunkSize);
+			writePosition = 0;
+		}
+		else if(sink)
+		{
+			if(compressor)
+				flushCompressed();
+			else
+				sink(bytes.data(), writePosition);
+
+			writePosition = 0;
+		}
+	}
+
+	const std::uint8_t* data() const
+	{
+		return viewData ? viewData : bytes.data();
+	}
+
+	std::size_t size() const
+	{
+		return viewData ? viewSize : bytes.size();
+	}
+
+	template<typename T>
+	struct Op
+	{
+		BasicPak& pak;
+
+		template<typename... Args>
+		void operator()(Args&&... args)
+		{
+			pak.parse(*this, args...);
+		}
+	};
+
+	struct Reserve;
+	struct Write;
+	struct Read;
+	struct Profile;
+
+	/*	Monotonic arena for deserialized object graphs
+
+		Allocations bump a pointer through fixed-size blocks and are only released
+		wholesale by reset() or destruction, turning the thousands of individual frees of
+		a per-request message graph into one pointer rewind. Pair it with ArenaAllocator:
+
+			typedef std::vector<int, Pak::ArenaAllocator<int>> Ints;
+
+			Pak::Arena arena;
+			Ints values{Pak::ArenaAllocator<int>(arena)};
+			p.read(values);
+
+		Fresh map/container elements are constructed with their container's allocator, so
+		single-level nesting lands in the arena automatically; for arbitrarily deep arena
+		graphs compose with std::scoped_allocator_adaptor.
+	*/
+	class Arena
+	{
+	public:
+		explicit Arena(std::size_t size = 1 << 16) : blockSize(size) {}
+
+		void* allocate(std::size_t numBytes, std::size_t alignment)
+		{
+			offset = (offset + alignment - 1) & ~(alignment - 1);
+
+			if(blocks.empty() || offset + numBytes > blocks.back().size())
+			{
+				blocks.emplace_back(numBytes > blockSize ? numBytes : blockSize);
+				offset = 0;
+			}
+
+			void* result = &blocks.back()[offset];
+			offset += numBytes;
+			return result;
+		}
+
+		//Rewinds to empty while keeping the first block's memory for reuse
+		void reset()
+		{
+			if(blocks.size() > 1)
+				blocks.erase(blocks.begin() + 1, blocks.end());
+
+			offset = 0;
+		}
+
+	private:
+		std::vector<std::vector<std::uint8_t>> blocks;
+		std::size_t blockSize;
+		std::size_t offset = 0;
+	};
+
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+
+		ArenaAllocator(Arena& a) : arena(&a) {}
+
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(std::size_t numElements)
+		{
+			return static_cast<T*>(arena->allocate(numElements * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, std::size_t) { } //Freed wholesale by Arena::reset()
+
+		template<typename U> bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+		template<typename U> bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+		Arena* arena;
+	};
+
+private:
+	//Compile-time sum of pak_static_size across an argument pack; known only if every
+	//argument's encoded size is known
+	template<typename... Args>
+	struct static_size
+	{
+		static const bool known = true;
+		static const std::size_t value = 0;
+	};
+
+	template<typename T, typename... Rest>
+	struct static_size<T, Rest...>
+	{
+		typedef pak_static_size<
+			typename std::remove_cv<typename std::remove_reference<T>::type>::type> head;
+
+		static const bool known = head::known && static_size<Rest...>::known;
+		static const std::size_t value = head::value + static_size<Rest...>::value;
+	};
+
+	// Variadic Template Evaluation ///////////////////////////////////////////////////////////////
+	template<typename OpType, typename T, typename... Args>
+	typename std::enable_if<is_iterator<typename std::remove_reference<T>::type>::value>::type
+		parse(Op<OpType> op, T&& begin, T&& end, Args&&... args) //Iterator pair
+	{
+		//An optimized version of this is called instead when dealing with contiguous primitives
+		for(auto it = begin; it != end; it++)
+			parse(op, *it);
+
+		parse(op, args...);
+	}
+
+	template<typename OpType, typename T, typename... Args>
+	void parse(Op<OpType> op, T&& t, Args&&... args) //Single argument
+	{
+		parse(op, t);
+		parse(op, args...);
+	}
+
+	template<typename OpType>
+	void parse(Op<OpType>) { } //No argument
+
+	// Contiguous Range Optimization //////////////////////////////////////////////////////////////
+	template<typename T>
+	using value_type = typename std::iterator_traits<T>::value_type;
+
+	template<typename T>
+	using enable_if_contiguous_range = typename std::enable_if<
+		is_iterator<T>::value &&
+		(std::is_arithmetic<value_type<T>>::value ||
+		 pak_trivially_serializable<value_type<T>>::value) &&
+		std::is_same<	typename std::iterator_traits<T>::iterator_category,
+						std::random_access_iterator_tag>::value>::type;
+
+	//True when an array of T can't be blitted as-is because the portable format demands
+	//per-field byte swapping on this host
+	template<typename T>
+	static bool mustParseElementwise()
+	{
+		return Portable && hostIsBigEndian() && !std::is_arithmetic<T>::value;
+	}
+
+	template<typename T>
+	static bool swapNeeded()
+	{
+		return Portable && shouldByteSwap<T>();
+	}
+
+	// Strings ////////////////////////////////////////////////////////////////////////////////////
+	//With interning off this produces exactly the generic container encoding; with it on,
+	//the low bit of the size prefix distinguishes a literal (length << 1, followed by the
+	//characters) from a back-reference (id << 1 | 1) into the dictionary of strings already
+	//emitted. Only plain char strings participate in the dictionary.
+	template<typename C, typename CT, typename A>
+	void parse(Op<Write> op, const std::basic_string<C, CT, A>& t)
+	{
+		if(interning && internedWrite(op, t))
+			return;
+
+		auto count = checkedSize(t.size());
+		parse(op, count);
+		parse(op, t.begin(), t.end());
+	}
+
+	template<typename C, typename CT, typename A>
+	void parse(Op<Write> op, std::basic_string<C, CT, A>& t)
+	{
+		parse(op, static_cast<const std::basic_string<C, CT, A>&>(t));
+	}
+
+	bool internedWrite(Op<Write> op, const std::string& t)
+	{
+		auto it = internWrite.find(t);
+		if(it != internWrite.end())
+		{
+			parse(op, SizeType((it->second << 1) | 1));
+			return true;
+		}
+
+		//Both the literal length and future reference ids lose a bit to the tag
+		const std::size_t limit = std::size_t((std::numeric_limits<SizeType>::max)() >> 1);
+		if(t.size() > limit)
+			throw std::length_error("Pak: string too long for the interned encoding");
+
+		parse(op, SizeType(t.size() << 1));
+		parse(op, t.begin(), t.end());
+
+		if(internWrite.size() <= limit)
+			internWrite.emplace(t, SizeType(internWrite.size()));
+
+		return true;
+	}
+
+	//Strings of other character types keep the plain encoding
+	template<typename S>
+	bool internedWrite(Op<Write>, const S&)
+	{
+		return false;
+	}
+
+	bool internedRead(Op<Read> op, std::string& t)
+	{
+		auto marker = read<SizeType>();
+
+		if(marker & 1)
+		{
+			std::size_t id = marker >> 1;
+			if(checked && id >= internRead.size())
+				throw std::out_of_range("Pak: interned string reference out of range");
+
+			//A back-reference materializes the full string from a few wire bytes, so it
+			//must charge the decode budget like the literal it stands in for
+			chargeDecode(internRead[id].size());
+			t = internRead[id];
+		}
+		else
+		{
+			readStringChars(t, marker >> 1);
+			internRead.push_back(t);
+		}
+
+		return true;
+	}
+
+	template<typename S>
+	bool internedRead(Op<Read>, S&)
+	{
+		return false;
+	}
+
+	//Fills a string straight from the buffer with assign(), skipping the zero-fill that
+	//resize() would perform on characters about to be overwritten anyway
+	template<typename C, typename CT, typename A>
+	void readStringChars(std::basic_string<C, CT, A>& t, std::size_t numElements)
+	{
+		requireElements(numElements);
+		chargeDecode(numElements);
+
+		if(!source && !swapNeeded<C>())
+		{
+			std::size_t numBytes = numElements * sizeof(C);
+			requireBytes(numBytes);
+			updateChecksum(&readData()[readPosition], numBytes);
+			t.assign(reinterpret_cast<const C*>(&readData()[readPosition]), numElements);
+			readPosition += numBytes;
+		}
+		else
+		{
+			t.resize(numElements);
+			if(numElements > 0)
+				parse(Op<Read>{*this}, &t[0], &t[0] + numElements);
+		}
+	}
+
+	template<typename C, typename CT, typename A>
+	void parse(Op<Read> op, std::basic_string<C, CT, A>& t)
+	{
+		if(interning && internedRead(op, t))
+			return;
+
+		readStringChars(t, read<SizeType>());
+	}
+
+	//The element type a container read produces: maps need the key's constness stripped
+	template<typename T, bool IsMap>
+	struct element_of
+	{
+		typedef typename T::value_type type;
+	};
+
+	template<typename T>
+	struct element_of<T, true>
+	{
+		typedef std::pair<	typename std::remove_const<typename T::key_type>::type,
+							typename T::mapped_type> type;
+	};
+
+	// Gather Mode ////////////////////////////////////////////////////////////////////////////////
+	//A run of bytes owned by the Pak (external == nullptr) or a reference into caller memory
+	struct GatherPiece
+	{
+		const std::uint8_t* external;
+		std::size_t offset;
+		std::size_t size;
+	};
+
+	//Closes the current Pak-owned run so an external reference can be spliced in after it
+	void closeGatherRun()
+	{
+		if(writePosition > gatherMark)
+			gatherPieces.push_back(GatherPiece{nullptr, gatherMark, writePosition - gatherMark});
+
+		gatherMark = writePosition;
+	}
+
+	template<typename T, typename... Args>
+	enable_if_contiguous_range<T> parse(Op<Reserve> op, T&& begin, T&& end, Args&&... args)
+	{
+		reserveSize += (end - begin) * sizeof(*begin);
+		parse(op, args...);
+	}
+
+	//Bytes are read either from the internal vector or from a non-owning view
+	const std::uint8_t* readData() const
+	{
+		return viewData ? viewData : bytes.data();
+	}
+
+	//Total bytes available behind readData()
+	std::size_t readLimit() const
+	{
+		return viewData ? viewSize : (source ? sourceEnd : bytes.size());
+	}
+
+	// Hardened Reads /////////////////////////////////////////////////////////////////////////////
+	void requireBytes(std::size_t numBytes) const
+	{
+		//The cursor can land past the limit through a hostile seek; testing that first
+		//keeps the subtraction from underflowing and waving everything through
+		if(checked && (readPosition > readLimit() || readLimit() - readPosition < numBytes))
+			throw std::out_of_range("Pak: read past end of buffer");
+	}
+
+	//Narrows a container count to the size-prefix type, failing loudly instead of
+	//truncating it into a corrupt stream
+	static SizeType checkedSize(std::size_t count)
+	{
+		if(count > (std::numeric_limits<SizeType>::max)())
+			throw std::length_error("Pak: container size exceeds the size-prefix type");
+
+		return static_cast<SizeType>(count);
+	}
+
+	//Each element costs at least one encoded byte, so a hostile size prefix can't trigger
+	//a multi-gigabyte allocation before the stream would run out anyway
+	void requireElements(std::size_t numElements) const
+	{
+		if(checked && !source &&
+		   (readPosition > readLimit() || numElements > readLimit() - readPosition))
+			throw std::length_error("Pak: container size exceeds remaining bytes");
+	}
+
+	// Decode Budget //////////////////////////////////////////////////////////////////////////////
+	//Charges a container's size prefix against the budget before any allocation or element
+	//work happens; one running total and two comparisons, so the hot path stays cheap
+	void chargeDecode(std::size_t numElements)
+	{
+		if(!limited)
+			return;
+
+		decodedElements += numElements;
+		if(decodedElements > decodeLimits.maxElements)
+			throw std::length_error("Pak: decode element budget exceeded");
+
+		if(readPosition > decodeLimits.maxBytes)
+			throw std::length_error("Pak: decode byte budget exceeded");
+	}
+
+	//Tracks container nesting through the recursive parse() dispatch, balancing the counter
+	//even when a nested read throws partway through
+	struct DecodeDepth
+	{
+		BasicPak* pak;
+
+		explicit DecodeDepth(BasicPak& p) : pak(&p)
+		{
+			if(pak->limited && pak->decodeDepth >= pak->decodeLimits.maxDepth)
+				throw std::length_error("Pak: decode nesting budget exceeded");
+
+			pak->decodeDepth++;
+		}
+
+		~DecodeDepth()
+		{
+			pak->decodeDepth--;
+		}
+	};
+
+	// Integrity //////////////////////////////////////////////////////////////////////////////////
+	//Folds bytes into the running digest; every call site hands over data that was just
+	//copied (or is about to be), so the bytes are hot when the CRC instructions touch them
+	void updateChecksum(const void* data, std::size_t numBytes)
+	{
+		if(checksumEnabled)
+			checksumState = crc32cUpdate(checksumState, (const std::uint8_t*)data, numBytes);
+	}
+
+	// Streaming //////////////////////////////////////////////////////////////////////////////////
+	//Writes are streamed through fixed-size blocks when a sink or chunked storage is active
+	bool streamingWrite() const
+	{
+		return chunked || (bool)sink;
+	}
+
+	//Returns a destination for numBytes of output, flushing the chunk to the sink when full
+	//or doubling the buffer when in single-pass growth mode
+	std::uint8_t* writeCursor(std::size_t numBytes)
+	{
+		if(writePosition + numBytes > bytes.size())
+		{
+			if(streamingWrite())
+			{
+				flush();
+			}
+			else if(growing)
+			{
+				std::size_t doubled = bytes.size() * 2;
+				std::size_t needed = writePosition + numBytes;
+				bytes.resize(doubled > needed ? doubled : (needed > 64 ? needed : 64));
+			}
+		}
+
+		return &bytes[writePosition];
+	}
+
+	//Appends raw bytes already in wire order, flushing full chunks to the sink as it goes
+	void writeStream(const std::uint8_t* src, std::size_t numBytes)
+	{
+		while(numBytes > 0)
+		{
+			if(writePosition == bytes.size())
+				flush();
+
+			std::size_t space = bytes.size() - writePosition;
+			std::size_t step = numBytes < space ? numBytes : space;
+
+			std::memcpy(&bytes[writePosition], src, step);
+			writePosition += step;
+			src += step;
+			numBytes -= step;
+		}
+	}
+
+	//Ensures at least numBytes are buffered contiguously ahead of the read cursor
+	void fill(std::size_t numBytes)
+	{
+		if(!source || sourceEnd - readPosition >= numBytes)
+			return;
+
+		std::size_t available = sourceEnd - readPosition;
+		if(available) //On a fresh Pak the buffer is still unallocated
+			std::memmove(bytes.data(), bytes.data() + readPosition, available);
+		readPosition = 0;
+		sourceEnd = available;
+
+		if(bytes.size() < chunkSize || bytes.size() < numBytes)
+			bytes.resize(chunkSize > numBytes ? chunkSize : numBytes);
+
+		while(sourceEnd < numBytes)
+		{
+			std::size_t pulled = decompressor ? pullCompressedBlock()
+											  : source(&bytes[sourceEnd], bytes.size() - sourceEnd);
+			if(pulled == 0)
+				break; //Source exhausted
+
+			sourceEnd += pulled;
+		}
+	}
+
+	// Compression ////////////////////////////////////////////////////////////////////////////////
+	//Seals the current block through the codec and frames it for the sink; blocks the codec
+	//can't shrink are stored raw, signalled by equal sizes in the frame header
+	void flushCompressed()
+	{
+		codecScratch.resize(writePosition);
+		std::size_t compressedSize =
+			compressor(codecScratch.data(), codecScratch.size(), bytes.data(), writePosition);
+
+		bool stored = compressedSize == 0 || compressedSize >= writePosition;
+		writeFrameHeader(stored ? (std::uint32_t)writePosition : (std::uint32_t)compressedSize,
+						 (std::uint32_t)writePosition);
+		sink(stored ? bytes.data() : codecScratch.data(), stored ? writePosition : compressedSize);
+	}
+
+	void writeFrameHeader(std::uint32_t compressedSize, std::uint32_t rawSize)
+	{
+		std::uint32_t header[2];
+		copyPrimitive(header[0], compressedSize);
+		copyPrimitive(header[1], rawSize);
+		sink((const std::uint8_t*)header, sizeof(header));
+	}
+
+	//Pulls exactly numBytes from the source, looping over short reads; false on clean exhaustion
+	bool pullExact(std::uint8_t* dst, std::size_t numBytes)
+	{
+		while(numBytes > 0)
+		{
+			std::size_t pulled = source(dst, numBytes);
+			if(pulled == 0)
+				return false;
+
+			dst += pulled;
+			numBytes -= pulled;
+		}
+
+		return true;
+	}
+
+	//Pulls one frame from the source and lands its decompressed bytes behind sourceEnd,
+	//returning how many were added (0 when the source is cleanly exhausted)
+	std::size_t pullCompressedBlock()
+	{
+		std::uint8_t rawHeader[8];
+		if(!pullExact(rawHeader, 1))
+			return 0; //No further frames
+
+		if(!pullExact(rawHeader + 1, sizeof(rawHeader) - 1))
+			throw std::runtime_error("Pak: truncated compressed frame header");
+
+		std::uint32_t compressedSize, rawSize, field;
+		std::memcpy(&field, rawHeader, 4);
+		copyPrimitive(compressedSize, field);
+		std::memcpy(&field, rawHeader + 4, 4);
+		copyPrimitive(rawSize, field);
+
+		if(bytes.size() < sourceEnd + rawSize)
+			bytes.resize(sourceEnd + rawSize);
+
+		if(compressedSize == rawSize) //Stored block
+		{
+			if(!pullExact(&bytes[sourceEnd], rawSize))
+				throw std::runtime_error("Pak: truncated compressed block");
+		}
+		else
+		{
+			codecScratch.resize(compressedSize);
+			if(!pullExact(codecScratch.data(), compressedSize))
+				throw std::runtime_error("Pak: truncated compressed block");
+
+			if(decompressor(&bytes[sourceEnd], rawSize, codecScratch.data(), compressedSize) != rawSize)
+				throw std::runtime_error("Pak: block failed to decompress");
+		}
+
+		return rawSize;
+	}
+
+	//Appends raw bytes that are already in wire order, through whichever backend is active
+	void putBytes(const std::uint8_t* src, std::size_t numBytes)
+	{
+		updateChecksum(src, numBytes);
+
+		if(streamingWrite())
+		{
+			writeStream(src, numBytes);
+		}
+		else
+		{
+			std::memcpy(writeCursor(numBytes), src, numBytes);
+			writePosition += numBytes;
+		}
+	}
+
+	// Profiling //////////////////////////////////////////////////////////////////////////////////
+	void recordProfile(const std::type_info& type, std::size_t numBytes, std::size_t numElements)
+	{
+		auto& entry = profileEntries[type.name()];
+		if(entry.type.empty())
+			entry.type = type.name();
+
+		entry.bytes += numBytes;
+		entry.elements += numElements;
+		entry.visits++;
+	}
+
+	//Actual encoded width of a scalar under the current settings
+	template<typename T>
+	typename std::enable_if<is_varintable<T>::value, std::size_t>::type profileScalarBytes(T t)
+	{
+		return compact ? varintSize(varintBits(t)) : sizeof(T);
+	}
+
+	template<typename T>
+	typename std::enable_if<!is_varintable<T>::value, std::size_t>::type profileScalarBytes(T)
+	{
+		return sizeof(T);
+	}
+
+	template<typename T>
+	typename std::enable_if<std::is_arithmetic<T>::value>::type
+		parse(Op<Profile>, T t)
+	{
+		std::size_t numBytes = profileScalarBytes(t);
+		recordProfile(typeid(T), numBytes, 1);
+		profileBytes += numBytes;
+	}
+
+	//Contiguous primitive ranges keep their fixed-width encoding even in compact mode
+	template<typename T, typename... Args>
+	enable_if_contiguous_range<T> parse(Op<Profile> op, T&& begin, T&& end, Args&&... args)
+	{
+		std::size_t numBytes = (end - begin) * sizeof(*begin);
+		recordProfile(typeid(value_type<T>), numBytes, end - begin);
+		profileBytes += numBytes;
+
+		parse(op, args...);
+	}
+
+	template<typename It>
+	void parse(Op<Profile>, DeltaRange<It> range)
+	{
+		std::size_t numBytes = 0, numElements = 0;
+		std::int64_t previous = 0;
+
+		for(auto it = range.begin; it != range.end; ++it, numElements++)
+		{
+			numBytes += varintSize(varintBits<std::int64_t>(std::int64_t(*it) - previous));
+			previous = std::int64_t(*it);
+		}
+
+		recordProfile(typeid(value_type<It>), numBytes, numElements);
+		profileBytes += numBytes;
+	}
 
-	template<typename... Args>
-	Pak(Args&&... args)
+	//User-defined types are charged for their whole subtree via the byte-counter delta
+	template<typename T>
+	typename std::enable_if<is_userdefined_internal<T, Op<Profile>>::value ||
+							is_userdefined_external<T, Op<Profile>>::value>::type
+		parse(Op<Profile> op, T& t)
 	{
-		write(args...);
+		std::size_t before = profileBytes;
+		profileDispatch(op, t);
+		recordProfile(typeid(T), profileBytes - before, 0);
 	}
 
-	template<typename... Args>
-	void write(Args&&... args)
+	template<typename T>
+	typename std::enable_if<is_userdefined_internal<T, Op<Profile>>::value>::type
+		profileDispatch(Op<Profile> op, T& t)
 	{
-		parse(Op<Reserve>{*this}, args...);
-		bytes.resize(bytes.size() + reserveSize);
-		parse(Op<Write>{*this}, args...);
+		t.serialize(op);
 	}
 
-	template<typename... Args>
-	void read(Args&&... args)
+	template<typename T>
+	typename std::enable_if<!is_userdefined_internal<T, Op<Profile>>::value &&
+							is_userdefined_external<T, Op<Profile>>::value>::type
+		profileDispatch(Op<Profile> op, T& t)
 	{
-		parse(Op<Read>{*this}, args...);
+		serialize(op, t);
 	}
 
+	// Varint Encoding ////////////////////////////////////////////////////////////////////////////
 	template<typename T>
-	T read()
+	static std::size_t varintReserve()
 	{
-		T t;
-		parse(Op<Read>{*this}, t);
-		return t;
+		return (sizeof(T) * 8 + 6) / 7; //Worst case: one byte per 7 bits of payload
 	}
 
-	const std::uint8_t* data() const
+	static std::size_t varintSize(std::uint64_t value)
 	{
-		return bytes.data();
+		std::size_t numBytes = 1;
+		while(value >>= 7)
+			numBytes++;
+
+		return numBytes;
 	}
 
-	std::size_t size() const
+	void writeVarint(std::uint64_t value)
 	{
-		return bytes.size();
+		std::uint8_t buffer[10];
+		std::size_t numBytes = 0;
+
+		do
+		{
+			std::uint8_t byte = value & 0x7F;
+			value >>= 7;
+			buffer[numBytes++] = byte | (value ? 0x80 : 0);
+		}
+		while(value);
+
+		putBytes(buffer, numBytes);
 	}
 
-	template<typename T>
-	struct Op
+	std::uint64_t readVarint()
 	{
-		Pak& pak;
+		std::uint64_t value = 0;
+		std::uint8_t byte;
+		unsigned shift = 0;
 
-		template<typename... Args>
-		void operator()(Args&&... args)
+		do
 		{
-			pak.parse(*this, args...);
+			//A 64-bit value spans at most 10 groups; a longer run of continuation bits is
+			//a hostile or corrupt stream, not an encoding this writer ever produces
+			if(shift >= 64)
+				throw std::length_error("Pak: overlong varint encoding");
+
+			fill(1);
+			requireBytes(1);
+			byte = readData()[readPosition++];
+			updateChecksum(&byte, 1);
+			value |= std::uint64_t(byte & 0x7F) << shift;
+			shift += 7;
 		}
-	};
+		while(byte & 0x80);
 
-	struct Reserve;
-	struct Write;
-	struct Read;
+		return value;
+	}
 
-private:
-	// Variadic Template Evaluation ///////////////////////////////////////////////////////////////
-	template<typename OpType, typename T, typename... Args>
-	typename std::enable_if<is_iterator<typename std::remove_reference<T>::type>::value>::type
-		parse(Op<OpType> op, T&& begin, T&& end, Args&&... args) //Iterator pair
+	//ZigZag maps signed values to unsigned so small negatives stay small on the wire
+	template<typename T>
+	static typename std::enable_if<std::is_signed<T>::value, std::uint64_t>::type
+		varintBits(T t)
 	{
-		//An optimized version of this is called instead when dealing with contiguous primitives
-		for(auto it = begin; it != end; it++)
-			parse(op, *it);
+		std::int64_t value = t;
+		return (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+	}
 
-		parse(op, args...);
+	template<typename T>
+	static typename std::enable_if<!std::is_signed<T>::value, std::uint64_t>::type
+		varintBits(T t)
+	{
+		return t;
 	}
 
-	template<typename OpType, typename T, typename... Args>
-	void parse(Op<OpType> op, T&& t, Args&&... args) //Single argument
+	template<typename T>
+	static typename std::enable_if<std::is_signed<T>::value, T>::type
+		varintValue(std::uint64_t bits)
 	{
-		parse(op, t);
-		parse(op, args...);
+		return T(std::int64_t(bits >> 1) ^ -std::int64_t(bits & 1));
 	}
 
-	template<typename OpType>
-	void parse(Op<OpType>) { } //No argument
+	template<typename T>
+	static typename std::enable_if<!std::is_signed<T>::value, T>::type
+		varintValue(std::uint64_t bits)
+	{
+		return T(bits);
+	}
 
-	// Contiguous Range Optimization //////////////////////////////////////////////////////////////
 	template<typename T>
-	using value_type = typename std::iterator_traits<T>::value_type;
+	typename std::enable_if<is_varintable<T>::value>::type writeCompact(T t)
+	{
+		writeVarint(varintBits(t));
+	}
 
 	template<typename T>
-	using enable_if_contiguous_range = typename std::enable_if<
-		is_iterator<T>::value &&
-		std::is_arithmetic<value_type<T>>::value &&
-		std::is_same<	typename std::iterator_traits<T>::iterator_category,
-						std::random_access_iterator_tag>::value>::type;
+	typename std::enable_if<is_varintable<T>::value>::type readCompact(T& t)
+	{
+		t = varintValue<T>(readVarint());
+	}
 
-	template<typename T, typename... Args>
-	enable_if_contiguous_range<T> parse(Op<Reserve> op, T&& begin, T&& end, Args&&... args)
+	//Unreachable fallbacks so the compact branch compiles for non-integral scalars
+	void writeCompact(...) { }
+	void readCompact(...) { }
+
+	//Consumes raw bytes, pulling chunks from the source as the buffered window runs dry
+	void readStream(std::uint8_t* dst, std::size_t numBytes)
 	{
-		reserveSize += (end - begin) * sizeof(*begin);
-		parse(op, args...);
+		while(numBytes > 0)
+		{
+			fill(1);
+
+			std::size_t available = sourceEnd - readPosition;
+			std::size_t step = numBytes < available ? numBytes : available;
+			if(step == 0)
+			{
+				if(checked)
+					throw std::out_of_range("Pak: source exhausted mid-read");
+
+				break; //Source exhausted
+			}
+
+			std::memcpy(dst, &bytes[readPosition], step);
+			readPosition += step;
+			dst += step;
+			numBytes -= step;
+		}
 	}
 
 	template<typename T>
-	void copyPrimitiveArray(T* dst, T* src, std::size_t numBytes)
+	void copyPrimitiveArray(T* dst, const T* src, std::size_t numBytes)
 	{
 		if(numBytes > 0)
 		{
+			if(swapNeeded<T>())
+			{
+				byteSwapCopy(dst, src, numBytes); //Swap fused into the copy, one pass over the data
+				return;
+			}
+
 			std::memcpy(dst, src, numBytes);
+		}
+	}
 
-			#ifdef PAK_PORTABLE_BINARY
-			if(shouldByteSwap<T>())
-			{
-				auto* current = dst;
-				auto* end = (T*)((std::uint8_t*)dst + numBytes);
+	//Partitions one large copy across the hardware threads; each worker owns a disjoint
+	//element-aligned slice of dst, so no synchronization is needed beyond the joins
+	template<typename T>
+	void copyPrimitiveArrayParallel(T* dst, const T* src, std::size_t numBytes)
+	{
+		std::size_t workers = std::thread::hardware_concurrency();
+		std::size_t numElements = numBytes / sizeof(T);
 
-				while(current < end)
-					byteSwap(*current++);
-			}
-			#endif
+		if(workers < 2 || numElements < workers)
+		{
+			copyPrimitiveArray(dst, src, numBytes);
+			return;
+		}
+
+		std::size_t step = numElements / workers;
+		std::vector<std::future<void>> tasks;
+
+		for(std::size_t w = 1; w < workers; w++)
+		{
+			std::size_t offset = w * step;
+			std::size_t count = (w == workers - 1) ? numElements - offset : step;
+
+			tasks.push_back(std::async(std::launch::async, [=]
+			{
+				copyPrimitiveArray(dst + offset, src + offset, count * sizeof(T));
+			}));
 		}
+
+		copyPrimitiveArray(dst, src, step * sizeof(T));
+
+		for(auto& task : tasks)
+			task.wait();
 	}
 
 	template<typename T, typename... Args>
 	enable_if_contiguous_range<T> parse(Op<Write> op, T&& begin, T&& end, Args&&... args)
 	{
 		std::size_t numBytes = (end - begin) * sizeof(*begin);
-		copyPrimitiveArray((value_type<T>*)&bytes[writePosition], &(*begin), numBytes);
-		writePosition += numBytes;
+
+		if(mustParseElementwise<value_type<T>>())
+		{
+			for(auto it = begin; it != end; it++)
+				parse(op, *it);
+		}
+		else if(streamingWrite())
+		{
+			writePrimitiveStream((const value_type<T>*)&(*begin), numBytes);
+		}
+		else if(gatherMinBytes > 0 && numBytes >= gatherMinBytes && !swapNeeded<value_type<T>>())
+		{
+			//Reference the caller's array instead of copying it; the bytes are already
+			//in wire order, so the segment list reproduces the exact stream
+			closeGatherRun();
+			gatherPieces.push_back(GatherPiece{(const std::uint8_t*)&(*begin), 0, numBytes});
+			updateChecksum(&(*begin), numBytes); //The referenced bytes are part of the stream
+		}
+		else if(parallelMinBytes > 0 && numBytes >= parallelMinBytes)
+		{
+			copyPrimitiveArrayParallel((value_type<T>*)writeCursor(numBytes), (const value_type<T>*)&(*begin), numBytes);
+			updateChecksum(&bytes[writePosition], numBytes);
+			writePosition += numBytes;
+		}
+		else
+		{
+			copyPrimitiveArray((value_type<T>*)writeCursor(numBytes), (const value_type<T>*)&(*begin), numBytes);
+			updateChecksum(&bytes[writePosition], numBytes);
+			writePosition += numBytes;
+		}
 
 		parse(op, args...);
 	}
@@ -216,12 +2281,61 @@ private:
 	enable_if_contiguous_range<T> parse(Op<Read> op, T&& begin, T&& end, Args&&... args)
 	{
 		std::size_t numBytes = (end - begin) * sizeof(*begin);
-		copyPrimitiveArray(&(*begin), (value_type<T>*)&bytes[readPosition], numBytes);
-		readPosition += numBytes;
-		
+
+		if(mustParseElementwise<value_type<T>>())
+		{
+			for(auto it = begin; it != end; it++)
+				parse(op, *it);
+		}
+		else if(source)
+		{
+			readPrimitiveStream(&(*begin), numBytes);
+		}
+		else
+		{
+			requireBytes(numBytes);
+			updateChecksum(&readData()[readPosition], numBytes);
+			copyPrimitiveArray(&(*begin), (const value_type<T>*)&readData()[readPosition], numBytes);
+			readPosition += numBytes;
+		}
+
 		parse(op, args...);
 	}
 
+	//Sink-backed variant of the Write fast path; swaps through a staging buffer when needed
+	template<typename T>
+	void writePrimitiveStream(const T* src, std::size_t numBytes)
+	{
+		if(swapNeeded<T>())
+		{
+			std::uint8_t staging[4096];
+			while(numBytes > 0)
+			{
+				std::size_t step = numBytes < sizeof(staging) ? numBytes : sizeof(staging);
+				copyPrimitiveArray((T*)staging, src, step);
+				updateChecksum(staging, step);
+				writeStream(staging, step);
+				src += step / sizeof(T);
+				numBytes -= step;
+			}
+			return;
+		}
+
+		updateChecksum(src, numBytes);
+		writeStream((const std::uint8_t*)src, numBytes);
+	}
+
+	//Source-backed variant of the Read fast path; swaps in place after the pull
+	template<typename T>
+	void readPrimitiveStream(T* dst, std::size_t numBytes)
+	{
+		readStream((std::uint8_t*)dst, numBytes);
+		updateChecksum(dst, numBytes); //Digest the wire bytes, before any in-place swap
+
+		if(swapNeeded<T>())
+			byteSwapCopy(dst, dst, numBytes); //In-place swap, the kernel tolerates dst == src
+	}
+
 	// Static Array ///////////////////////////////////////////////////////////////////////////////
 	template<typename OpType, typename T, std::size_t S>
 	void parse(Op<OpType> op, T(&t)[S])
@@ -233,6 +2347,39 @@ private:
 		parse(op, begin, end);
 	}
 
+	// Delta Range ////////////////////////////////////////////////////////////////////////////////
+	template<typename It>
+	void parse(Op<Reserve>, DeltaRange<It> range)
+	{
+		for(auto it = range.begin; it != range.end; ++it)
+			reserveSize += varintReserve<value_type<It>>();
+	}
+
+	template<typename It>
+	void parse(Op<Write>, DeltaRange<It> range)
+	{
+		std::int64_t previous = 0;
+
+		for(auto it = range.begin; it != range.end; ++it)
+		{
+			std::int64_t value = std::int64_t(*it);
+			writeVarint(varintBits(value - previous));
+			previous = value;
+		}
+	}
+
+	template<typename It>
+	void parse(Op<Read>, DeltaRange<It> range)
+	{
+		std::int64_t previous = 0;
+
+		for(auto it = range.begin; it != range.end; ++it)
+		{
+			previous += varintValue<std::int64_t>(readVarint());
+			*it = value_type<It>(previous);
+		}
+	}
+
 	// Pair ///////////////////////////////////////////////////////////////////////////////////////
 	template<typename OpType, typename T, typename U>
 	void parse(Op<OpType> op, std::pair<T, U>& t)
@@ -252,30 +2399,135 @@ private:
 	typename std::enable_if<is_container<T>::value>::type
 		parse(Op<OpType> op, T& container)
 	{
-		auto containerSize = static_cast<std::uint32_t>(container.size());
+		auto containerSize = checkedSize(container.size());
 		parse(op, containerSize);
 		parse(op, container.begin(), container.end());
 	}
 
+	//Constructs a fresh element with the container's allocator when the type accepts one,
+	//so nested structures land in the same arena as their parent container
+	template<typename T, typename A>
+	static typename std::enable_if<std::uses_allocator<T, A>::value, T>::type
+		makeElement(const A& allocator)
+	{
+		return T(allocator);
+	}
+
+	template<typename T, typename A>
+	static typename std::enable_if<!std::uses_allocator<T, A>::value, T>::type
+		makeElement(const A&)
+	{
+		return T();
+	}
+
+	//Pre-sizes hashed containers so the insert loop below never rehashes incrementally;
+	//the bucket array is allocated once for the final element count instead of growing
+	//(and re-bucketing every node) several times on the way there. Ordered node-based
+	//containers have no equivalent and take the no-op overload.
 	template<typename T>
-	typename std::enable_if<is_map<T>::value>::type
-		parse(Op<Read>, T& t)
+	typename std::enable_if<is_hashed<T>::value>::type
+		reserveHashed(T& t, std::size_t numElements)
 	{
-		auto numElements = read<std::uint32_t>();
+		t.reserve(numElements);
+	}
 
-		typedef std::pair<	typename std::remove_const<typename T::key_type>::type,
-							typename T::mapped_type> value_type;
+	template<typename T>
+	typename std::enable_if<!is_hashed<T>::value>::type
+		reserveHashed(T&, std::size_t)
+	{
+	}
+
+	template<typename T>
+	typename std::enable_if<is_map<T>::value &&
+							is_equality_comparable<typename T::key_type>::value>::type
+		parse(Op<Read> op, T& t)
+	{
+		auto numElements = read<SizeType>();
+		requireElements(numElements);
+		chargeDecode(numElements);
+		DecodeDepth depth(*this);
+		reserveHashed(t, numElements);
+
+		typedef typename std::remove_const<typename T::key_type>::type key_type;
+		typedef std::pair<key_type, typename T::mapped_type> value_type;
+
+		//Overwrite the values of existing nodes while the incoming keys match the current
+		//contents; when the key set is unchanged (the common case for long-lived message
+		//objects) this touches no nodes and reuses every nested allocation
+		key_type key = makeElement<key_type>(t.get_allocator());
+		auto it = t.begin();
+		SizeType i = 0;
+		bool mismatched = false;
+
+		while(i < numElements && it != t.end())
+		{
+			parse(op, key);
+			i++;
+
+			if(key == it->first)
+			{
+				parse(op, it->second);
+				++it;
+			}
+			else
+			{
+				mismatched = true;
+				break;
+			}
+		}
+
+		t.erase(it, t.end()); //Stale remainder, rebuilt below if more elements are incoming
+
+		if(mismatched)
+		{
+			value_type pending(std::move(key), makeElement<typename T::mapped_type>(t.get_allocator()));
+			parse(op, pending.second);
+			t.insert(t.end(), std::move(pending));
+		}
+
+		for(; i < numElements; i++)
+		{
+			value_type element(makeElement<key_type>(t.get_allocator()),
+							   makeElement<typename T::mapped_type>(t.get_allocator()));
+			parse(op, element);
+			t.insert(t.end(), std::move(element));
+		}
+	}
+
+	template<typename T>
+	typename std::enable_if<is_map<T>::value &&
+							!is_equality_comparable<typename T::key_type>::value>::type
+		parse(Op<Read> op, T& t)
+	{
+		auto numElements = read<SizeType>();
+		requireElements(numElements);
+		chargeDecode(numElements);
+		DecodeDepth depth(*this);
+		reserveHashed(t, numElements);
+
+		typedef typename std::remove_const<typename T::key_type>::type key_type;
+		typedef std::pair<key_type, typename T::mapped_type> value_type;
 
 		t.clear();
-		for(std::uint32_t i = 0; i < numElements; i++)
-			t.insert(t.end(), read<value_type>());
+		for(SizeType i = 0; i < numElements; i++)
+		{
+			value_type element(makeElement<key_type>(t.get_allocator()),
+							   makeElement<typename T::mapped_type>(t.get_allocator()));
+			parse(op, element);
+			t.insert(t.end(), std::move(element));
+		}
 	}
 
 	template<typename T>
 	typename std::enable_if<is_container<T>::value && !is_map<T>::value>::type
 		parse(Op<Read> op, T& t)
 	{
-		t.resize(read<std::uint32_t>());
+		auto numElements = read<SizeType>();
+		requireElements(numElements);
+		chargeDecode(numElements);
+		DecodeDepth depth(*this);
+
+		t.resize(numElements);
 		parse(op, t.begin(), t.end());
 	}
 
@@ -315,7 +2567,10 @@ private:
 	typename std::enable_if<std::is_arithmetic<T>::value>::type
 		parse(Op<Reserve>, T)
 	{
-		reserveSize += sizeof(T);
+		if(compact && is_varintable<T>::value)
+			reserveSize += varintReserve<T>();
+		else
+			reserveSize += sizeof(T);
 	}
 
 	template<typename T>
@@ -323,20 +2578,38 @@ private:
 	{
 		dst = src;
 
-		#ifdef PAK_PORTABLE_BINARY
-		if(shouldByteSwap<T>())
-		{
+		if(swapNeeded<T>())
 			byteSwap(dst);
-		}
-		#endif
+	}
+
+	//Fixed-width scalar transfer regardless of the compact flag, used directly by the
+	//footer formats whose tables must stay seekable
+	template<typename T>
+	void writeFixed(T t)
+	{
+		copyPrimitive(*reinterpret_cast<T*>(writeCursor(sizeof(T))), t);
+		updateChecksum(&bytes[writePosition], sizeof(T));
+		writePosition += sizeof(T);
+	}
+
+	template<typename T>
+	void readFixed(T& t)
+	{
+		fill(sizeof(T));
+		requireBytes(sizeof(T));
+		updateChecksum(&readData()[readPosition], sizeof(T));
+		copyPrimitive(t, *reinterpret_cast<const T*>(&readData()[readPosition]));
+		readPosition += sizeof(T);
 	}
 
 	template<typename T>
 	typename std::enable_if<std::is_arithmetic<T>::value>::type
 		parse(Op<Write>, T t)
 	{
-		copyPrimitive(*reinterpret_cast<T*>(&bytes[writePosition]), t);
-		writePosition += sizeof(T);
+		if(compact && is_varintable<T>::value)
+			writeCompact(t);
+		else
+			writeFixed(t);
 	}
 
 	template<typename T>
@@ -344,12 +2617,151 @@ private:
 		parse(Op<Read>, T& t)
 	{
 		static_assert(!std::is_const<T>::value, "Pak cannot read into a const value");
-		copyPrimitive(t, *reinterpret_cast<T*>(&bytes[readPosition]));
-		readPosition += sizeof(T);
+
+		if(compact && is_varintable<T>::value)
+			readCompact(t);
+		else
+			readFixed(t);
+	}
+
+	// SoA Columns ////////////////////////////////////////////////////////////////////////////////
+	//Stand-in op passed to serialize() that forwards only the target field to the real op,
+	//so one pass over the container emits one column
+	template<typename OpType>
+	struct FieldOp
+	{
+		BasicPak* pak;
+		std::size_t target;
+
+		template<typename... Args>
+		void operator()(Args&&... args)
+		{
+			select(0, std::forward<Args>(args)...);
+		}
+
+		void select(std::size_t) { }
+
+		template<typename A, typename... Rest>
+		void select(std::size_t index, A&& a, Rest&&... rest)
+		{
+			if(index == target)
+				pak->parse(Op<OpType>{*pak}, a);
+			else
+				select(index + 1, std::forward<Rest>(rest)...);
+		}
+	};
+
+	//Probe op that just reports how many fields the member list declares
+	struct FieldCount
+	{
+		std::size_t* count;
+
+		template<typename... Args>
+		void operator()(Args&&...)
+		{
+			*count = sizeof...(Args);
+		}
+	};
+
+	template<typename FieldOpType, typename T>
+	typename std::enable_if<is_userdefined_internal<T, FieldOpType>::value>::type
+		fieldDispatch(FieldOpType op, T& t)
+	{
+		t.serialize(op);
+	}
+
+	template<typename FieldOpType, typename T>
+	typename std::enable_if<!is_userdefined_internal<T, FieldOpType>::value &&
+							is_userdefined_external<T, FieldOpType>::value>::type
+		fieldDispatch(FieldOpType op, T& t)
+	{
+		serialize(op, t);
+	}
+
+	template<typename T>
+	std::size_t fieldCount(T& element)
+	{
+		std::size_t count = 0;
+		fieldDispatch(FieldCount{&count}, element);
+		return count;
+	}
+
+	template<typename T>
+	void writeSoAColumns(T& container)
+	{
+		if(container.begin() == container.end())
+			return;
+
+		std::size_t numFields = fieldCount(*container.begin());
+		for(std::size_t field = 0; field < numFields; field++)
+			for(auto it = container.begin(); it != container.end(); ++it)
+				fieldDispatch(FieldOp<Write>{this, field}, *it);
+	}
+
+	// Field Index ////////////////////////////////////////////////////////////////////////////////
+	void writeFieldsImpl(std::size_t, std::vector<std::uint64_t>&) { }
+
+	template<typename T, typename... Rest>
+	void writeFieldsImpl(std::size_t start, std::vector<std::uint64_t>& offsets, T&& t, Rest&&... rest)
+	{
+		offsets.push_back(writePosition - start);
+		writeSinglePass(std::forward<T>(t));
+		writeFieldsImpl(start, offsets, std::forward<Rest>(rest)...);
 	}
 
 	std::vector<std::uint8_t> bytes;
+	const std::uint8_t* viewData = nullptr;
+	std::size_t viewSize = 0;
+	std::shared_ptr<const std::uint8_t> mapping;
+	Sink sink;
+	Source source;
+	Codec compressor;
+	Codec decompressor;
+	std::vector<std::uint8_t> codecScratch;
+	bool chunked = false;
+	std::vector<std::vector<std::uint8_t>> chunks;
+	std::size_t chunkSize = 0;
+	std::size_t sourceEnd = 0;
+	bool growing = false;
+	bool compact = false;
+	bool checked = false;
+	bool checksumEnabled = false;
+	std::uint32_t checksumState = 0xFFFFFFFF;
+	std::size_t parallelMinBytes = 0;
+	std::size_t gatherMinBytes = 0;
+	std::size_t gatherMark = 0;
+	std::vector<GatherPiece> gatherPieces;
 	std::size_t reserveSize = 0;
 	std::size_t writePosition = 0;
 	std::size_t readPosition = 0;
+	std::map<std::string, ProfileEntry> profileEntries;
+	std::size_t profileBytes = 0;
+	bool interning = false;
+	std::unordered_map<std::string, SizeType> internWrite;
+	std::vector<std::string> internRead;
+	DecodeLimits decodeLimits = {};
+	bool limited = false;
+	std::size_t decodedElements = 0;
+	std::size_t decodeDepth = 0;
 };
+
+/*	Archive flavors
+
+	PortablePak emits the byte-order-independent wire format; NativePak emits host byte
+	order with every swap branch compiled out, for IPC between machines known to share an
+	architecture. Both are ordinary types that coexist in one binary. The Pak name follows
+	the PAK_PORTABLE_BINARY macro above, so existing code keeps its behavior.
+
+	The second parameter picks the container size-prefix width per archive — for example
+	BasicPak<true, std::uint64_t> for datasets beyond four billion elements, or
+	BasicPak<true, std::uint16_t> to shave prefix bytes off small-message traffic
+	(setCompactIntegers() is the varint alternative). Writer and reader must agree.
+*/
+typedef BasicPak<true> PortablePak;
+typedef BasicPak<false> NativePak;
+
+#ifdef PAK_PORTABLE_BINARY
+	typedef PortablePak Pak;
+#else
+	typedef NativePak Pak;
+#endif
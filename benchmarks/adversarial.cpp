@@ -0,0 +1,144 @@
+//Copyright (C) 2016 Daniel Wade < danwade@hotmail.com >
+//
+//This source code is subject to the terms of the MIT license
+//See http://opensource.org/licenses/MIT
+
+/*	Worst-case decode benchmarks on adversarial input
+
+	Correctness benchmarks measure the average payload; tail latency is set by the worst
+	payload an attacker (or a corrupted stream) can craft. Each case here builds a hostile
+	byte stream by hand — nesting prefixes thousands of levels deep, or chaining maximal
+	size prefixes — and reports how long a decode with setDecodeLimits() takes to reject
+	it, alongside a legitimate decode of similar size for scale. The rejection times bound
+	p99.9 deserialization latency: if a case regresses, the budget enforcement has moved
+	off the cheap path.
+*/
+
+#include "Pak.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	//Runs the workload until ~0.4s has elapsed and prints microseconds per decode attempt
+	template<typename Workload>
+	void benchmark(const char* name, Workload workload)
+	{
+		workload(); //Warm caches and allocations before timing
+
+		auto start = Clock::now();
+		std::size_t iterations = 0;
+		double elapsed = 0.0;
+
+		do
+		{
+			workload();
+			iterations++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		while(elapsed < 0.4);
+
+		std::printf("%-28s %12.2f us/decode  (%zu iters)\n",
+					name, elapsed / iterations * 1e6, iterations);
+	}
+
+	//A self-recursive type: each count=1 prefix in the stream opens another level
+	struct Tree
+	{
+		std::vector<Tree> children;
+
+		template<typename T>
+		void serialize(T t)
+		{
+			t(children);
+		}
+	};
+
+	const Pak::DecodeLimits limits = {1 << 20, 16 << 20, 64};
+
+	//Expects the decode to be rejected by the budget; a pass means the case is broken
+	template<typename T>
+	void decodeExpectingRejection(const Pak& hostile, T& target)
+	{
+		Pak r = Pak::view(hostile.data(), hostile.size());
+		r.setDecodeLimits(limits);
+
+		try
+		{
+			r.read(target);
+			std::printf("ERROR: hostile input decoded without tripping a limit\n");
+		}
+		catch(const std::length_error&)
+		{
+		}
+	}
+
+	//100k levels of count=1 vector prefixes: unbudgeted, this recurses parse() until the
+	//stack gives out; budgeted, it must fail at maxDepth in microseconds
+	void benchDeepNesting()
+	{
+		const std::uint32_t depth = 100000;
+		Pak hostile;
+		for(std::uint32_t i = 0; i < depth; i++)
+			hostile.write(std::uint32_t(1));
+		hostile.write(std::uint32_t(0));
+
+		benchmark("deep nesting reject", [&]
+		{
+			Tree target;
+			decodeExpectingRejection(hostile, target);
+		});
+	}
+
+	//A modest outer count followed by maximal inner prefixes: each one alone passes the
+	//remaining-bytes check against a large buffer, so only the element budget stops the
+	//decode before it tries a multi-gigabyte resize
+	void benchHostilePrefixes()
+	{
+		Pak hostile;
+		hostile.write(std::uint32_t(1000));
+		for(std::uint32_t i = 0; i < 1000; i++)
+			hostile.write(std::uint32_t(0xFFFFFFFF));
+
+		//Pad so the prefixes don't fail the cheap remaining-bytes comparison first
+		std::vector<std::uint8_t> padding(32 << 20, 0);
+		hostile.write(padding.begin(), padding.end());
+
+		benchmark("hostile prefixes reject", [&]
+		{
+			std::vector<std::vector<std::uint8_t>> target;
+			decodeExpectingRejection(hostile, target);
+		});
+	}
+
+	//The same budget on a legitimate payload near the caps, for scale: this is the decode
+	//cost a well-behaved worst case actually pays
+	void benchBudgetedLegitimate()
+	{
+		std::vector<std::vector<std::uint32_t>> rows(1024);
+		for(std::size_t i = 0; i < rows.size(); i++)
+			rows[i].assign(256, (std::uint32_t)i);
+
+		Pak p(rows);
+
+		benchmark("legitimate under budget", [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			r.setDecodeLimits(limits);
+			std::vector<std::vector<std::uint32_t>> target;
+			r.read(target);
+		});
+	}
+}
+
+int main()
+{
+	benchDeepNesting();
+	benchHostilePrefixes();
+	benchBudgetedLegitimate();
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+//Copyright (C) 2016 Daniel Wade < danwade@hotmail.com >
+//
+//This source code is subject to the terms of the MIT license
+//See http://opensource.org/licenses/MIT
+
+/*	Throughput benchmarks for the distinct dispatch paths in Pak::parse()
+
+	Each benchmark repeats its workload until enough wall time has elapsed for a stable
+	measurement and reports GB/s of payload moved, so changes to any fast path (or a
+	compiler upgrade) can be validated with numbers instead of guesswork.
+
+	Paths covered: primitive scalars, the contiguous-range optimization, static arrays,
+	map reads, deep user-defined graphs, string-heavy payloads, and the portable-binary
+	byte-swap kernel (run on swapped input to simulate the big-endian cost on any host).
+*/
+
+#include "Pak.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	//Runs the workload until ~0.4s has elapsed and prints GB/s of payload per iteration
+	template<typename Workload>
+	void benchmark(const char* name, std::size_t bytesPerIteration, Workload workload)
+	{
+		workload(); //Warm caches and allocations before timing
+
+		auto start = Clock::now();
+		std::size_t iterations = 0;
+		double elapsed = 0.0;
+
+		do
+		{
+			workload();
+			iterations++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		while(elapsed < 0.4);
+
+		double gbPerSecond = (double)bytesPerIteration * iterations / elapsed / 1e9;
+		std::printf("%-24s %10.3f GB/s  (%zu bytes/iter, %zu iters)\n",
+					name, gbPerSecond, bytesPerIteration, iterations);
+	}
+
+	struct Vec3
+	{
+		float x, y, z;
+
+		template<typename T>
+		void serialize(T t)
+		{
+			t(x, y, z);
+		}
+	};
+
+	struct Node
+	{
+		std::uint64_t id;
+		std::vector<Vec3> points;
+		std::map<std::uint32_t, float> weights;
+
+		template<typename T>
+		void serialize(T t)
+		{
+			t(id, points, weights);
+		}
+	};
+
+	void benchScalars()
+	{
+		const std::size_t count = 1 << 20;
+		Pak p;
+
+		benchmark("scalar write", count * sizeof(std::uint32_t), [&]
+		{
+			p = Pak();
+			for(std::uint32_t i = 0; i < count; i += 4)
+				p.write(i, i + 1, i + 2, i + 3);
+		});
+
+		benchmark("scalar read", count * sizeof(std::uint32_t), [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			std::uint32_t a, b, c, d;
+			for(std::uint32_t i = 0; i < count; i += 4)
+				r.read(a, b, c, d);
+		});
+	}
+
+	void benchContiguousRange()
+	{
+		std::vector<float> values(16 * 1024 * 1024);
+		for(std::size_t i = 0; i < values.size(); i++)
+			values[i] = (float)i;
+
+		const std::size_t numBytes = values.size() * sizeof(float);
+		Pak p;
+
+		benchmark("contiguous write", numBytes, [&]
+		{
+			p = Pak();
+			p.write(values.begin(), values.end());
+		});
+
+		benchmark("contiguous read", numBytes, [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			r.read(values.begin(), values.end());
+		});
+	}
+
+	void benchStaticArray()
+	{
+		static int matrix[64][4096];
+		for(int i = 0; i < 64; i++)
+			for(int j = 0; j < 4096; j++)
+				matrix[i][j] = i * j;
+
+		Pak p;
+		benchmark("static array write", sizeof(matrix), [&]
+		{
+			p = Pak();
+			p.write(matrix);
+		});
+	}
+
+	void benchMapRead()
+	{
+		std::map<std::uint32_t, std::uint64_t> source;
+		for(std::uint32_t i = 0; i < 100000; i++)
+			source[i] = i * 7ULL;
+
+		Pak p(source);
+		std::map<std::uint32_t, std::uint64_t> target;
+
+		benchmark("map read", p.size(), [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			r.read(target); //Second iteration onward exercises the node-reuse path
+		});
+	}
+
+	void benchUserDefinedGraph()
+	{
+		std::vector<Node> nodes(512);
+		for(std::size_t i = 0; i < nodes.size(); i++)
+		{
+			nodes[i].id = i;
+			nodes[i].points.resize(64, Vec3{1.0f, 2.0f, 3.0f});
+			for(std::uint32_t w = 0; w < 16; w++)
+				nodes[i].weights[w] = (float)w;
+		}
+
+		Pak p(nodes);
+		std::vector<Node> target;
+
+		benchmark("user-defined write", p.size(), [&]
+		{
+			Pak q;
+			q.write(nodes);
+		});
+
+		benchmark("user-defined read", p.size(), [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			r.read(target);
+		});
+	}
+
+	void benchStrings()
+	{
+		std::vector<std::string> keys(100000);
+		for(std::size_t i = 0; i < keys.size(); i++)
+			keys[i] = "key-" + std::to_string(i * 2654435761u);
+
+		Pak p(keys);
+		std::vector<std::string> target;
+
+		benchmark("string-heavy write", p.size(), [&]
+		{
+			Pak q;
+			q.write(keys);
+		});
+
+		benchmark("string-heavy read", p.size(), [&]
+		{
+			Pak r = Pak::view(p.data(), p.size());
+			r.read(target);
+		});
+	}
+
+	#ifdef PAK_PORTABLE_BINARY
+	//Runs the swap kernel directly on swapped input, simulating what every array copy
+	//costs on a big-endian host regardless of the endianness of the machine running this
+	void benchByteSwap()
+	{
+		std::vector<std::uint32_t> source(16 * 1024 * 1024), dest(source.size());
+		for(std::size_t i = 0; i < source.size(); i++)
+			source[i] = (std::uint32_t)i * 2654435761u;
+
+		const std::size_t numBytes = source.size() * sizeof(std::uint32_t);
+
+		benchmark("byteswap copy u32", numBytes, [&]
+		{
+			byteSwapCopy(dest.data(), source.data(), numBytes);
+		});
+
+		std::vector<std::uint64_t> source64(8 * 1024 * 1024), dest64(source64.size());
+		benchmark("byteswap copy u64", source64.size() * sizeof(std::uint64_t), [&]
+		{
+			byteSwapCopy(dest64.data(), source64.data(), source64.size() * sizeof(std::uint64_t));
+		});
+	}
+	#endif
+}
+
+int main()
+{
+	benchScalars();
+	benchContiguousRange();
+	benchStaticArray();
+	benchMapRead();
+	benchUserDefinedGraph();
+	benchStrings();
+
+	#ifdef PAK_PORTABLE_BINARY
+	benchByteSwap();
+	#endif
+
+	return 0;
+}